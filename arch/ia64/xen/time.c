@@ -92,7 +92,6 @@ consider_steal_time(unsigned long new_itm)
 	unsigned long delta_itm = 0, stolentick = 0;
 	int cpu = smp_processor_id();
 	struct vcpu_runstate_info runstate;
-	struct task_struct *p = current;
 
 	get_runstate_snapshot(&runstate);
 
@@ -136,7 +135,6 @@ consider_steal_time(unsigned long new_itm)
 		rcu_check_callbacks(cpu, user_mode(get_irq_regs()));
 
 		scheduler_tick();
-		run_posix_cpu_timers(p);
 		delta_itm += local_cpu_data->itm_delta * (stolen + blocked);
 
 		if (cpu == time_keeper_id)
@@ -28,3 +28,12 @@ void arch_irq_work_raise(void)
 	apic_wait_icr_idle();
 #endif
 }
+
+bool arch_irq_work_has_interrupt(void)
+{
+#ifdef CONFIG_X86_LOCAL_APIC
+	return cpu_has_apic;
+#else
+	return false;
+#endif
+}
@@ -52,14 +52,12 @@ static inline u64 get_cpu_idle_time_jiffy(unsigned int cpu, u64 *wall)
 
 u64 get_cpu_idle_time(unsigned int cpu, u64 *wall)
 {
-	u64 idle_time = get_cpu_idle_time_us(cpu, NULL);
+	u64 idle_time, iowait_time;
 
-	if (idle_time == -1ULL)
+	if (get_cpu_sleep_time_us(cpu, &idle_time, &iowait_time, wall))
 		return get_cpu_idle_time_jiffy(cpu, wall);
-	else
-		idle_time += get_cpu_iowait_time_us(cpu, wall);
 
-	return idle_time;
+	return idle_time + iowait_time;
 }
 EXPORT_SYMBOL_GPL(get_cpu_idle_time);
 
@@ -21,6 +21,8 @@ typedef u64 __nocast cputime64_t;
 	jiffies64_to_cputime64(nsecs_to_jiffies64(__nsec))
 #define nsecs_to_cputime(__nsec)	\
 	jiffies_to_cputime(nsecs_to_jiffies(__nsec))
+#define cputime_to_nsecs(__ct)		\
+	((u64)cputime_to_jiffies(__ct) * (NSEC_PER_SEC / HZ))
 
 
 /*
@@ -39,6 +39,7 @@ typedef u64 __nocast cputime64_t;
  * Convert cputime <-> nanoseconds
  */
 #define nsecs_to_cputime(__nsecs)	((__force u64)(__nsecs))
+#define cputime_to_nsecs(__ct)		((__force u64)(__ct))
 
 
 /*
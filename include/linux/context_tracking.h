@@ -4,13 +4,15 @@
 #ifdef CONFIG_CONTEXT_TRACKING
 #include <linux/sched.h>
 #include <linux/percpu.h>
+#include <linux/static_key.h>
 
 struct context_tracking {
 	/*
 	 * When active is false, probes are unset in order
 	 * to minimize overhead: TIF flags are cleared
-	 * and calls to user_enter/exit are ignored. This
-	 * may be further optimized using static keys.
+	 * and calls to user_enter/exit are ignored. When
+	 * no CPU is active, the context_tracking_enabled
+	 * static key further turns the probes into nops.
 	 */
 	bool active;
 	enum {
@@ -19,24 +21,54 @@ struct context_tracking {
 	} state;
 };
 
+extern struct static_key context_tracking_enabled;
 DECLARE_PER_CPU(struct context_tracking, context_tracking);
 
+/* Is there any CPU doing context tracking? */
+static inline bool context_tracking_is_enabled(void)
+{
+	return static_key_false(&context_tracking_enabled);
+}
+
 static inline bool context_tracking_in_user(void)
 {
-	return __this_cpu_read(context_tracking.state) == IN_USER;
+	return context_tracking_is_enabled() &&
+	       __this_cpu_read(context_tracking.state) == IN_USER;
 }
 
 static inline bool context_tracking_active(void)
 {
-	return __this_cpu_read(context_tracking.active);
+	return context_tracking_is_enabled() &&
+	       __this_cpu_read(context_tracking.active);
+}
+
+extern void context_tracking_cpu_set(int cpu);
+extern void context_tracking_user_enter(void);
+extern void context_tracking_user_exit(void);
+extern void __context_tracking_task_switch(struct task_struct *prev,
+					   struct task_struct *next);
+
+static inline void user_enter(void)
+{
+	if (context_tracking_is_enabled())
+		context_tracking_user_enter();
 }
 
-extern void user_enter(void);
-extern void user_exit(void);
-extern void context_tracking_task_switch(struct task_struct *prev,
-					 struct task_struct *next);
+static inline void user_exit(void)
+{
+	if (context_tracking_is_enabled())
+		context_tracking_user_exit();
+}
+
+static inline void context_tracking_task_switch(struct task_struct *prev,
+						struct task_struct *next)
+{
+	if (context_tracking_is_enabled())
+		__context_tracking_task_switch(prev, next);
+}
 #else
 static inline bool context_tracking_in_user(void) { return false; }
+static inline void context_tracking_cpu_set(int cpu) { }
 static inline void user_enter(void) { }
 static inline void user_exit(void) { }
 static inline void context_tracking_task_switch(struct task_struct *prev,
@@ -147,6 +147,8 @@ extern struct task_group root_task_group;
 # define INIT_VTIME(tsk)						\
 	.vtime_seqlock = __SEQLOCK_UNLOCKED(tsk.vtime_seqlock),	\
 	.vtime_snap = 0,				\
+	.vtime_utime_pending = 0,			\
+	.vtime_stime_pending = 0,			\
 	.vtime_snap_whence = VTIME_SYS,
 #else
 # define INIT_VTIME(tsk)
@@ -15,7 +15,7 @@
 #define IRQ_WORK_PENDING	1UL
 #define IRQ_WORK_BUSY		2UL
 #define IRQ_WORK_FLAGS		3UL
-#define IRQ_WORK_LAZY		4UL /* Doesn't want IPI, wait for tick */
+#define IRQ_WORK_LAZY		4UL /* No IPI, wait for the next interrupt */
 
 struct irq_work {
 	unsigned long flags;
@@ -30,14 +30,27 @@ void init_irq_work(struct irq_work *work, void (*func)(struct irq_work *))
 	work->func = func;
 }
 
+static inline
+void init_irq_work_lazy(struct irq_work *work, void (*func)(struct irq_work *))
+{
+	work->flags = IRQ_WORK_LAZY;
+	work->func = func;
+}
+
 void irq_work_queue(struct irq_work *work);
+#ifdef CONFIG_SMP
+bool irq_work_queue_on(struct irq_work *work, int cpu);
+#endif
 void irq_work_run(void);
 void irq_work_sync(struct irq_work *work);
+bool arch_irq_work_has_interrupt(void);
 
 #ifdef CONFIG_IRQ_WORK
 bool irq_work_needs_cpu(void);
+void irq_work_run_lazy(void);
 #else
 static bool irq_work_needs_cpu(void) { return false; }
+static inline void irq_work_run_lazy(void) { }
 #endif
 
 #endif /* _LINUX_IRQ_WORK_H */
@@ -418,6 +418,7 @@ struct perf_event {
 	int				pending_kill;
 	int				pending_disable;
 	struct irq_work			pending;
+	struct irq_work			pending_wakeup_work;
 
 	atomic_t			event_limit;
 
@@ -119,6 +119,9 @@ int posix_timer_event(struct k_itimer *timr, int si_private);
 void posix_cpu_timer_schedule(struct k_itimer *timer);
 
 void run_posix_cpu_timers(struct task_struct *task);
+void posix_cpu_timers_kick(struct task_struct *task);
+void posix_cpu_timers_kick_cpu(int cpu);
+void posix_cpu_timers_task_switch(struct task_struct *task);
 void posix_cpu_timers_exit(struct task_struct *task);
 void posix_cpu_timers_exit_group(struct task_struct *task);
 
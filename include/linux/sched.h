@@ -8,6 +8,44 @@ struct sched_param {
 	int sched_priority;
 };
 
+#define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
+
+/*
+ * Extended scheduling parameters data structure, used by the
+ * sched_setattr() and sched_getattr() syscalls.
+ *
+ * @size is the size of the structure as known by the caller, so that
+ * the structure can grow while staying binary compatible.
+ *
+ * @sched_policy, @sched_flags, @sched_nice and @sched_priority carry
+ * what sched_setscheduler() and setpriority() already handle, the
+ * latter being the RT priority of SCHED_FIFO and SCHED_RR tasks.
+ *
+ * @sched_runtime, @sched_deadline and @sched_period (in nanoseconds)
+ * describe the SCHED_DEADLINE reservation: each instance of the task
+ * is guaranteed @sched_runtime of CPU time within @sched_deadline of
+ * its activation, and instances can't be activated more often than
+ * every @sched_period. A zero @sched_period means equal to the
+ * deadline.
+ */
+struct sched_attr {
+	u32 size;
+
+	u32 sched_policy;
+	u64 sched_flags;
+
+	/* SCHED_NORMAL, SCHED_BATCH */
+	s32 sched_nice;
+
+	/* SCHED_FIFO, SCHED_RR */
+	u32 sched_priority;
+
+	/* SCHED_DEADLINE */
+	u64 sched_runtime;
+	u64 sched_deadline;
+	u64 sched_period;
+};
+
 #include <asm/param.h>	/* for HZ */
 
 #include <linux/capability.h>
@@ -245,7 +283,7 @@ extern int runqueue_is_locked(int cpu);
 #if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ)
 extern void nohz_balance_enter_idle(int cpu);
 extern void set_cpu_sd_state_idle(void);
-extern int get_nohz_timer_target(void);
+extern int get_nohz_timer_target(int pinned);
 #else
 static inline void nohz_balance_enter_idle(int cpu) { }
 static inline void set_cpu_sd_state_idle(void) { }
@@ -549,6 +587,10 @@ struct signal_struct {
 	/* Earliest-expiration cache. */
 	struct task_cputime cputime_expires;
 
+#ifdef CONFIG_NO_HZ_FULL
+	atomic_t tick_dep_mask;
+#endif
+
 	struct list_head cpu_timers[3];
 
 	struct pid *tty_old_pgrp;
@@ -814,6 +856,7 @@ enum cpu_idle_type {
 #define SD_ASYM_PACKING		0x0800  /* Place busy groups earlier in the domain */
 #define SD_PREFER_SIBLING	0x1000	/* Prefer to place tasks in a sibling domain */
 #define SD_OVERLAP		0x2000	/* sched_domains of this level overlap */
+#define SD_NUMA			0x4000	/* cross-node balancing */
 
 extern int __weak arch_sd_sibiling_asym_packing(void);
 
@@ -883,6 +926,27 @@ struct sched_domain_attr {
 
 extern int sched_domain_level_max;
 
+/*
+ * State shared by all the CPUs of a last level cache domain, see
+ * update_idle_core() and select_idle_core().
+ */
+struct sched_domain_shared {
+	atomic_t	ref;
+	/*
+	 * CPUs whose whole core is idle, all the SMT siblings of such
+	 * a core are set. This is only a hint, it is maintained on idle
+	 * entry and exit and may be stale.
+	 *
+	 * NOTE: this field is variable length, see sched_domain::span.
+	 */
+	unsigned long	idle_cores[0];
+};
+
+static inline struct cpumask *sds_idle_cores(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_cores);
+}
+
 struct sched_domain {
 	/* These fields must be setup */
 	struct sched_domain *parent;	/* top domain must be null terminated */
@@ -909,6 +973,9 @@ struct sched_domain {
 
 	u64 last_update;
 
+	/* select_idle_cpu() scan cost, decaying average in ns */
+	u64 avg_scan_cost;
+
 #ifdef CONFIG_SCHEDSTATS
 	/* load_balance() stats */
 	unsigned int lb_count[CPU_MAX_IDLE_TYPES];
@@ -947,6 +1014,7 @@ struct sched_domain {
 		void *private;		/* used during construction */
 		struct rcu_head rcu;	/* used during destruction */
 	};
+	struct sched_domain_shared *shared;
 
 	unsigned int span_weight;
 	/*
@@ -1019,6 +1087,7 @@ struct uts_namespace;
 
 struct rq;
 struct sched_domain;
+struct numa_group;
 
 /*
  * wake flags
@@ -1034,6 +1103,7 @@ struct sched_domain;
 #else
 #define ENQUEUE_WAKING		0
 #endif
+#define ENQUEUE_REPLENISH	8	/* SCHED_DEADLINE budget refill */
 
 #define DEQUEUE_SLEEP		1
 
@@ -1067,8 +1137,10 @@ struct sched_class {
 #endif
 
 	void (*set_curr_task) (struct rq *rq);
+	void (*update_curr) (struct rq *rq);
 	void (*task_tick) (struct rq *rq, struct task_struct *p, int queued);
 	void (*task_fork) (struct task_struct *p);
+	void (*task_dead) (struct task_struct *p);
 
 	void (*switched_from) (struct rq *this_rq, struct task_struct *task);
 	void (*switched_to) (struct rq *this_rq, struct task_struct *task);
@@ -1094,9 +1166,13 @@ struct sched_avg {
 	 * choices of y < 1-2^(-32)*1024.
 	 */
 	u32 runnable_avg_sum, runnable_avg_period;
+	/* Same series, for the time the entity was actually running */
+	u32 running_avg_sum;
 	u64 last_runnable_update;
 	s64 decay_count;
 	unsigned long load_avg_contrib;
+	/* Fraction of a cpu used by the entity, in SCHED_POWER_SCALE units */
+	unsigned long utilization_avg_contrib;
 };
 
 #ifdef CONFIG_SCHEDSTATS
@@ -1160,12 +1236,7 @@ struct sched_entity {
 	struct cfs_rq		*my_q;
 #endif
 
-/*
- * Load-tracking only depends on SMP, FAIR_GROUP_SCHED dependency below may be
- * removed when useful for applications beyond shares distribution (e.g.
- * load-balance).
- */
-#if defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)
+#ifdef CONFIG_SMP
 	/* Per-entity load-tracking */
 	struct sched_avg	avg;
 #endif
@@ -1187,6 +1258,38 @@ struct sched_rt_entity {
 #endif
 };
 
+struct sched_dl_entity {
+	struct rb_node	rb_node;
+
+	/*
+	 * Original scheduling parameters, copied from the sched_attr of
+	 * the last sched_setattr(). dl_bw is dl_runtime / dl_period in
+	 * the fixed point format of the admission control.
+	 */
+	u64 dl_runtime;		/* maximum runtime of each instance	*/
+	u64 dl_deadline;	/* relative deadline of each instance	*/
+	u64 dl_period;		/* separation of two instances		*/
+	u64 dl_bw;		/* reserved bandwidth			*/
+	unsigned int dl_bw_gen;	/* root domain rebuild that counted it	*/
+
+	/*
+	 * Actual scheduling parameters of the current instance, updated
+	 * as the task runs. The runtime goes negative on overruns.
+	 */
+	s64 runtime;		/* remaining runtime of this instance	*/
+	u64 deadline;		/* absolute deadline of this instance	*/
+
+	/*
+	 * dl_throttled: the budget is exhausted and the task waits for
+	 * dl_timer to replenish it at the start of the next period.
+	 *
+	 * dl_new: the parameters have just been set and the next
+	 * enqueue starts a fresh instance.
+	 */
+	int dl_throttled, dl_new;
+
+	struct hrtimer dl_timer;
+};
 
 struct rcu_node;
 
@@ -1215,6 +1318,7 @@ struct task_struct {
 	const struct sched_class *sched_class;
 	struct sched_entity se;
 	struct sched_rt_entity rt;
+	struct sched_dl_entity dl;
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
 #endif
@@ -1260,6 +1364,7 @@ struct task_struct {
 	struct list_head tasks;
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
+	struct rb_node pushable_dl_tasks;
 #endif
 
 	struct mm_struct *mm, *active_mm;
@@ -1333,6 +1438,9 @@ struct task_struct {
 #ifdef CONFIG_VIRT_CPU_ACCOUNTING_GEN
 	seqlock_t vtime_seqlock;
 	unsigned long long vtime_snap;
+	/* Lazy mode time not yet folded into utime/stime (nsecs) */
+	unsigned long long vtime_utime_pending;
+	unsigned long long vtime_stime_pending;
 	enum {
 		VTIME_SLEEPING = 0,
 		VTIME_USER,
@@ -1347,6 +1455,9 @@ struct task_struct {
 
 	struct task_cputime cputime_expires;
 	struct list_head cpu_timers[3];
+#ifdef CONFIG_NO_HZ_FULL
+	atomic_t tick_dep_mask;
+#endif
 
 /* process credentials */
 	const struct cred __rcu *real_cred; /* objective and real subjective task
@@ -1504,6 +1615,20 @@ struct task_struct {
 	unsigned int numa_scan_period;
 	u64 node_stamp;			/* migration stamp  */
 	struct callback_head numa_work;
+
+	int numa_preferred_nid;
+	unsigned long numa_migrate_retry;	/* jiffies */
+	struct numa_group *numa_group;
+
+	/*
+	 * Exponential decaying average of the NUMA hinting faults the task
+	 * took on each node, split into shared and private faults. The
+	 * faults of the current scan are gathered in numa_faults_buffer
+	 * and folded in when the scan completes, see task_numa_placement().
+	 */
+	unsigned long *numa_faults;
+	unsigned long *numa_faults_buffer;
+	unsigned long total_numa_faults;
 #endif /* CONFIG_NUMA_BALANCING */
 
 	struct rcu_head rcu;
@@ -1582,15 +1707,25 @@ struct task_struct {
 #define tsk_cpus_allowed(tsk) (&(tsk)->cpus_allowed)
 
 #ifdef CONFIG_NUMA_BALANCING
-extern void task_numa_fault(int node, int pages, bool migrated);
+extern void task_numa_fault(int last_nidpid, int node, int pages,
+			    bool migrated);
 extern void set_numabalancing_state(bool enabled);
+extern void task_numa_free(struct task_struct *p);
+extern void mm_numa_free(struct mm_struct *mm);
 #else
-static inline void task_numa_fault(int node, int pages, bool migrated)
+static inline void task_numa_fault(int last_nidpid, int node, int pages,
+				   bool migrated)
 {
 }
 static inline void set_numabalancing_state(bool enabled)
 {
 }
+static inline void task_numa_free(struct task_struct *p)
+{
+}
+static inline void mm_numa_free(struct mm_struct *mm)
+{
+}
 #endif
 
 static inline struct pid *task_pid(struct task_struct *task)
@@ -2002,6 +2137,7 @@ static inline void disable_sched_clock_irqtime(void) {}
 
 extern unsigned long long
 task_sched_runtime(struct task_struct *task);
+extern void sched_update_curr_runtime(void);
 
 /* sched_exec is called by processes performing an exec */
 #ifdef CONFIG_SMP
@@ -2021,8 +2157,10 @@ static inline void idle_task_exit(void) {}
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
 extern void wake_up_idle_cpu(int cpu);
+extern void wake_up_nohz_cpu(int cpu);
 #else
 static inline void wake_up_idle_cpu(int cpu) { }
+static inline void wake_up_nohz_cpu(int cpu) { }
 #endif
 
 #ifdef CONFIG_SCHED_AUTOGROUP
@@ -2047,11 +2185,14 @@ extern int task_prio(const struct task_struct *p);
 extern int task_nice(const struct task_struct *p);
 extern int can_nice(const struct task_struct *p, const int nice);
 extern int task_curr(const struct task_struct *p);
+extern int task_curr_cpu(struct task_struct *p);
 extern int idle_cpu(int cpu);
 extern int sched_setscheduler(struct task_struct *, int,
 			      const struct sched_param *);
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
 				      const struct sched_param *);
+extern int sched_setattr(struct task_struct *,
+			 const struct sched_attr *);
 extern struct task_struct *idle_task(int cpu);
 /**
  * is_idle_task - is the specified task an idle task?
@@ -2131,7 +2272,7 @@ extern void wake_up_new_task(struct task_struct *tsk);
 #else
  static inline void kick_process(struct task_struct *tsk) { }
 #endif
-extern void sched_fork(struct task_struct *p);
+extern int sched_fork(struct task_struct *p);
 extern void sched_dead(struct task_struct *p);
 
 extern void proc_caches_init(void);
@@ -0,0 +1,25 @@
+#ifndef _SCHED_DEADLINE_H
+#define _SCHED_DEADLINE_H
+
+/*
+ * SCHED_DEADLINE tasks have negative priorities, reflecting the fact
+ * that any of them has higher priority than the RT and the
+ * SCHED_NORMAL/SCHED_BATCH tasks. Among themselves they are ordered
+ * by their absolute deadline, not by priority.
+ */
+
+#define MAX_DL_PRIO		0
+
+static inline int dl_prio(int prio)
+{
+	if (unlikely(prio < MAX_DL_PRIO))
+		return 1;
+	return 0;
+}
+
+static inline int dl_task(struct task_struct *p)
+{
+	return dl_prio(p->prio);
+}
+
+#endif /* _SCHED_DEADLINE_H */
@@ -30,13 +30,10 @@
 #define _LINUX_SRCU_H
 
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
 #include <linux/rcupdate.h>
 #include <linux/workqueue.h>
-
-struct srcu_struct_array {
-	unsigned long c[2];
-	unsigned long seq[2];
-};
+#include <linux/completion.h>
 
 struct rcu_batch {
 	struct rcu_head *head, **tail;
@@ -44,18 +41,73 @@ struct rcu_batch {
 
 #define RCU_BATCH_INIT(name) { NULL, &(name.head) }
 
+/*
+ * Per-CPU structure feeding into leaf srcu_node, similar in function
+ * to rcu_data.  Holds both the reader counters and the callbacks queued
+ * from this CPU, each batch of callbacks tagged with the grace-period
+ * sequence number that it waits for.
+ */
+struct srcu_data {
+	/* Read-side state. */
+	unsigned long c[2];		/* Readers per index. */
+	unsigned long seq[2];		/* Validates the sum of ->c[]. */
+
+	/* Update-side state. */
+	spinlock_t lock;		/* Protects all fields below. */
+	struct rcu_batch batch_done;	/* Ready to invoke. */
+	struct rcu_batch batch_wait;	/* Waiting for ->gp_seq_wait. */
+	struct rcu_batch batch_next;	/* Waiting for ->gp_seq_next. */
+	unsigned long gp_seq_wait;
+	unsigned long gp_seq_next;
+	unsigned long srcu_gp_seq_needed; /* Furthest future GP needed. */
+	unsigned long srcu_gp_seq_needed_exp; /* Furthest future exp GP. */
+	bool srcu_cblist_invoking;	/* Invoking these CBs? */
+	struct delayed_work work;	/* Context for CB invoking. */
+	struct rcu_head srcu_barrier_head; /* For srcu_barrier() use. */
+	struct srcu_node *mynode;	/* Leaf srcu_node. */
+	unsigned long grpmask;		/* Mask for leaf srcu_node. */
+	int cpu;
+	struct srcu_struct *sp;
+};
+
+/*
+ * Leaf node of the SRCU funnel, one per SRCU_FANOUT_LEAF CPUs.  Records
+ * which of its CPUs have callbacks waiting for a given grace period so
+ * that only these get to invoke callbacks once it has elapsed, and
+ * absorbs the requests for a grace period that is already requested.
+ */
+struct srcu_node {
+	spinlock_t lock;
+	unsigned long srcu_have_cbs[4];	/* GP seq for children having CBs. */
+	unsigned long srcu_data_have_cbs[4]; /* Which srcu_data have CBs. */
+	unsigned long srcu_gp_seq_needed_exp; /* Furthest future exp GP. */
+	int grplo;			/* Least CPU for node. */
+};
+
+#ifdef CONFIG_RCU_FANOUT_LEAF
+#define SRCU_FANOUT_LEAF	CONFIG_RCU_FANOUT_LEAF
+#else /* #ifdef CONFIG_RCU_FANOUT_LEAF */
+#define SRCU_FANOUT_LEAF	16
+#endif /* #else #ifdef CONFIG_RCU_FANOUT_LEAF */
+#define SRCU_NUM_NODES		DIV_ROUND_UP(NR_CPUS, SRCU_FANOUT_LEAF)
+
 struct srcu_struct {
-	unsigned completed;
-	struct srcu_struct_array __percpu *per_cpu_ref;
-	spinlock_t queue_lock; /* protect ->batch_queue, ->running */
-	bool running;
-	/* callbacks just queued */
-	struct rcu_batch batch_queue;
-	/* callbacks try to do the first check_zero */
-	struct rcu_batch batch_check0;
-	/* callbacks done with the first check_zero and the flip */
-	struct rcu_batch batch_check1;
-	struct rcu_batch batch_done;
+	unsigned completed;		/* Flips of the reader index. */
+	struct srcu_data __percpu *sda;	/* Per-CPU srcu_data array. */
+	struct srcu_node *node;		/* Leaf srcu_node array. */
+	int srcu_num_nodes;
+	bool srcu_initialized;		/* Are sda and node set up? */
+	spinlock_t lock;		/* Protects ->srcu_gp_seq*. */
+	struct mutex srcu_cb_mutex;	/* Serialize CB preparation. */
+	struct mutex srcu_gp_mutex;	/* Serialize GP work. */
+	unsigned long srcu_gp_seq;	/* Grace-period seq #. */
+	unsigned long srcu_gp_seq_needed; /* Latest gp_seq needed. */
+	unsigned long srcu_gp_seq_needed_exp; /* Furthest future exp GP. */
+	unsigned long srcu_last_gp_end;	/* Last GP end timestamp (ns). */
+	struct mutex srcu_barrier_mutex; /* Serialize barrier ops. */
+	struct completion srcu_barrier_completion; /* Awaken barrier rq. */
+	atomic_t srcu_barrier_cpu_cnt;	/* # CPUs not yet posting a */
+					/*  callback to be invoked. */
 	struct delayed_work work;
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map dep_map;
@@ -84,16 +136,22 @@ int init_srcu_struct(struct srcu_struct *sp);
 
 void process_srcu(struct work_struct *work);
 
+/*
+ * The srcu_data and srcu_node structures of a statically defined
+ * srcu_struct are initialized on first use of the update side.
+ */
 #define __SRCU_STRUCT_INIT(name)					\
 	{								\
 		.completed = -300,					\
-		.per_cpu_ref = &name##_srcu_array,			\
-		.queue_lock = __SPIN_LOCK_UNLOCKED(name.queue_lock),	\
-		.running = false,					\
-		.batch_queue = RCU_BATCH_INIT(name.batch_queue),	\
-		.batch_check0 = RCU_BATCH_INIT(name.batch_check0),	\
-		.batch_check1 = RCU_BATCH_INIT(name.batch_check1),	\
-		.batch_done = RCU_BATCH_INIT(name.batch_done),		\
+		.sda = &name##_srcu_data,				\
+		.node = name##_srcu_node,				\
+		.srcu_num_nodes = SRCU_NUM_NODES,			\
+		.srcu_initialized = false,				\
+		.lock = __SPIN_LOCK_UNLOCKED(name.lock),		\
+		.srcu_cb_mutex = __MUTEX_INITIALIZER(name.srcu_cb_mutex), \
+		.srcu_gp_mutex = __MUTEX_INITIALIZER(name.srcu_gp_mutex), \
+		.srcu_barrier_mutex =					\
+			__MUTEX_INITIALIZER(name.srcu_barrier_mutex),	\
 		.work = __DELAYED_WORK_INITIALIZER(name.work, process_srcu, 0),\
 		__SRCU_DEP_MAP_INIT(name)				\
 	}
@@ -103,11 +161,13 @@ void process_srcu(struct work_struct *work);
  * dont't call init_srcu_struct() nor cleanup_srcu_struct() on it.
  */
 #define DEFINE_SRCU(name)						\
-	static DEFINE_PER_CPU(struct srcu_struct_array, name##_srcu_array);\
+	static DEFINE_PER_CPU(struct srcu_data, name##_srcu_data);	\
+	static struct srcu_node name##_srcu_node[SRCU_NUM_NODES];	\
 	struct srcu_struct name = __SRCU_STRUCT_INIT(name);
 
 #define DEFINE_STATIC_SRCU(name)					\
-	static DEFINE_PER_CPU(struct srcu_struct_array, name##_srcu_array);\
+	static DEFINE_PER_CPU(struct srcu_data, name##_srcu_data);	\
+	static struct srcu_node name##_srcu_node[SRCU_NUM_NODES];	\
 	static struct srcu_struct name = __SRCU_STRUCT_INIT(name);
 
 /**
@@ -22,6 +22,7 @@ struct timer_list {
 	unsigned long data;
 
 	int slack;
+	unsigned int wheel_idx;
 
 #ifdef CONFIG_TIMER_STATS
 	int start_pid;
@@ -194,6 +195,12 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 extern unsigned long get_next_timer_interrupt(unsigned long now);
 
+/*
+ * Number of non-pinned timers that could not be moved away from a
+ * full dynticks CPU:
+ */
+extern unsigned long timer_nr_unmovable(int cpu);
+
 /*
  * Timer-statistics info:
  */
@@ -203,8 +203,9 @@ extern void __inc_zone_state(struct zone *, enum zone_stat_item);
 extern void dec_zone_state(struct zone *, enum zone_stat_item);
 extern void __dec_zone_state(struct zone *, enum zone_stat_item);
 
-void refresh_cpu_vm_stats(int);
+int refresh_cpu_vm_stats(int);
 void refresh_zone_stat_thresholds(void);
+void quiet_vmstat(void);
 
 void drain_zonestat(struct zone *zone, struct per_cpu_pageset *);
 
@@ -260,6 +261,7 @@ static inline void __dec_zone_page_state(struct page *page,
 
 static inline void refresh_cpu_vm_stats(int cpu) { }
 static inline void refresh_zone_stat_thresholds(void) { }
+static inline void quiet_vmstat(void) { }
 
 static inline void drain_zonestat(struct zone *zone,
 			struct per_cpu_pageset *pset) { }
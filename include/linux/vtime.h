@@ -28,10 +28,7 @@ extern void arch_vtime_task_switch(struct task_struct *tsk);
 extern void vtime_account_irq_exit(struct task_struct *tsk);
 extern bool vtime_accounting_enabled(void);
 extern void vtime_user_enter(struct task_struct *tsk);
-static inline void vtime_user_exit(struct task_struct *tsk)
-{
-	vtime_account_user(tsk);
-}
+extern void vtime_user_exit(struct task_struct *tsk);
 extern void vtime_guest_enter(struct task_struct *tsk);
 extern void vtime_guest_exit(struct task_struct *tsk);
 extern void vtime_init_idle(struct task_struct *tsk);
@@ -11,6 +11,7 @@
 #include <linux/lockdep.h>
 #include <linux/threads.h>
 #include <linux/atomic.h>
+#include <linux/cpumask.h>
 
 struct workqueue_struct;
 
@@ -422,6 +423,7 @@ extern bool schedule_delayed_work_on(int cpu, struct delayed_work *work,
 extern bool schedule_delayed_work(struct delayed_work *work,
 				  unsigned long delay);
 extern int schedule_on_each_cpu(work_func_t func);
+extern int schedule_on_cpu_mask(work_func_t func, const struct cpumask *mask);
 extern int keventd_up(void);
 
 int execute_in_process_context(work_func_t fn, struct execute_work *);
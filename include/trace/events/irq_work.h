@@ -0,0 +1,96 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM irq_work
+
+#if !defined(_TRACE_IRQ_WORK_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_IRQ_WORK_H
+
+#include <linux/tracepoint.h>
+#include <linux/irq_work.h>
+
+/**
+ * irq_work_queue - called when an irq_work is enqueued
+ * @work:	pointer to struct irq_work
+ * @cpu:	the CPU the work is enqueued on
+ *
+ * When used in combination with the irq_work_entry tracepoint of the
+ * same @cpu, we can build per CPU histograms of the delivery latency
+ * of lazy and urgent works.
+ */
+TRACE_EVENT(irq_work_queue,
+
+	TP_PROTO(struct irq_work *work, int cpu),
+
+	TP_ARGS(work, cpu),
+
+	TP_STRUCT__entry(
+		__field( void *,	work	)
+		__field( void *,	function)
+		__field( int,		cpu	)
+		__field( int,		lazy	)
+	),
+
+	TP_fast_assign(
+		__entry->work		= work;
+		__entry->function	= work->func;
+		__entry->cpu		= cpu;
+		__entry->lazy		= !!(work->flags & IRQ_WORK_LAZY);
+	),
+
+	TP_printk("work=%p function=%pf cpu=%d lazy=%d",
+		  __entry->work, __entry->function, __entry->cpu, __entry->lazy)
+);
+
+/**
+ * irq_work_entry - called immediately before the irq_work callback
+ * @work:	pointer to struct irq_work
+ */
+TRACE_EVENT(irq_work_entry,
+
+	TP_PROTO(struct irq_work *work),
+
+	TP_ARGS(work),
+
+	TP_STRUCT__entry(
+		__field( void *,	work	)
+		__field( void *,	function)
+		__field( int,		lazy	)
+	),
+
+	TP_fast_assign(
+		__entry->work		= work;
+		__entry->function	= work->func;
+		__entry->lazy		= !!(work->flags & IRQ_WORK_LAZY);
+	),
+
+	TP_printk("work=%p function=%pf lazy=%d",
+		  __entry->work, __entry->function, __entry->lazy)
+);
+
+/**
+ * irq_work_exit - called immediately after the irq_work callback returns
+ * @work:	pointer to struct irq_work
+ *
+ * When used in combination with the irq_work_entry tracepoint we can
+ * determine the runtime of the callback function.
+ */
+TRACE_EVENT(irq_work_exit,
+
+	TP_PROTO(struct irq_work *work),
+
+	TP_ARGS(work),
+
+	TP_STRUCT__entry(
+		__field( void *,	work	)
+	),
+
+	TP_fast_assign(
+		__entry->work		= work;
+	),
+
+	TP_printk("work=%p", __entry->work)
+);
+
+#endif /*  _TRACE_IRQ_WORK_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
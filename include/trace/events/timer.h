@@ -7,6 +7,7 @@
 #include <linux/tracepoint.h>
 #include <linux/hrtimer.h>
 #include <linux/timer.h>
+#include <linux/tick.h>
 
 DECLARE_EVENT_CLASS(timer_class,
 
@@ -323,6 +324,42 @@ TRACE_EVENT(itimer_expire,
 		  (int) __entry->pid, (unsigned long long)__entry->now)
 );
 
+#ifdef CONFIG_NO_HZ
+#define show_tick_dep_name(val)						\
+	__print_symbolic(val,						\
+		{ TICK_DEP_MASK_NONE,		"NONE" },		\
+		{ TICK_DEP_MASK_PERF_EVENTS,	"PERF_EVENTS" },	\
+		{ TICK_DEP_MASK_SCHED,		"SCHED" },		\
+		{ TICK_DEP_MASK_CLOCK_UNSTABLE,	"CLOCK_UNSTABLE" },	\
+		{ TICK_DEP_MASK_RCU,		"RCU" },		\
+		{ TICK_DEP_MASK_IRQ_WORK,	"IRQ_WORK" })
+
+/**
+ * tick_stop - called when a busy CPU tries to stop its tick
+ * @success:	whether the tick could be stopped
+ * @dependency:	the dependency mask bit which kept the tick alive
+ */
+TRACE_EVENT(tick_stop,
+
+	TP_PROTO(int success, int dependency),
+
+	TP_ARGS(success, dependency),
+
+	TP_STRUCT__entry(
+		__field( int ,		success	)
+		__field( int ,		dependency )
+	),
+
+	TP_fast_assign(
+		__entry->success	= success;
+		__entry->dependency	= dependency;
+	),
+
+	TP_printk("success=%d dependency=%s",  __entry->success,
+		  show_tick_dep_name(__entry->dependency))
+);
+#endif
+
 #endif /*  _TRACE_TIMER_H */
 
 /* This part must be outside protection */
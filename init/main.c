@@ -546,6 +546,7 @@ asmlinkage void __init start_kernel(void)
 	}
 	idr_init_cache();
 	perf_event_init();
+	tick_nohz_init();
 	rcu_init();
 	radix_tree_init();
 	/* init some links before init_ISA_irqs() */
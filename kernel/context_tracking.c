@@ -20,23 +20,54 @@
 #include <linux/sched.h>
 #include <linux/hardirq.h>
 #include <linux/export.h>
+#include <linux/init.h>
+
+/*
+ * Enabled as soon as a CPU does context tracking, the probes are nops
+ * until then.
+ */
+struct static_key context_tracking_enabled = STATIC_KEY_INIT_FALSE;
+EXPORT_SYMBOL_GPL(context_tracking_enabled);
+
+DEFINE_PER_CPU(struct context_tracking, context_tracking);
+
+/**
+ * context_tracking_cpu_set - Enable the context tracking on a CPU
+ * @cpu: the CPU to probe on user/kernel boundaries
+ *
+ * Must be called before the CPU runs any task, typically at boot time
+ * by the full dynticks subsystem for the CPUs in its range.
+ */
+void context_tracking_cpu_set(int cpu)
+{
+	if (!per_cpu(context_tracking.active, cpu)) {
+		per_cpu(context_tracking.active, cpu) = true;
+		static_key_slow_inc(&context_tracking_enabled);
+	}
+}
 
-DEFINE_PER_CPU(struct context_tracking, context_tracking) = {
 #ifdef CONFIG_CONTEXT_TRACKING_FORCE
-	.active = true,
+static int __init context_tracking_force_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		context_tracking_cpu_set(cpu);
+	return 0;
+}
+early_initcall(context_tracking_force_init);
 #endif
-};
 
 /**
- * user_enter - Inform the context tracking that the CPU is going to
- *              enter userspace mode.
+ * context_tracking_user_enter - Inform the context tracking that the CPU
+ *                               is going to enter userspace mode.
  *
  * This function must be called right before we switch from the kernel
  * to userspace, when it's guaranteed the remaining kernel instructions
  * to execute won't use any RCU read side critical section because this
  * function sets RCU in extended quiescent state.
  */
-void user_enter(void)
+void context_tracking_user_enter(void)
 {
 	unsigned long flags;
 
@@ -51,6 +82,14 @@ void user_enter(void)
 	if (in_interrupt())
 		return;
 
+	/*
+	 * Don't go further on CPUs that aren't tracked.  Should we migrate
+	 * to a tracked CPU right after that check, we'll only miss the
+	 * tick stop until the next kernel entry.
+	 */
+	if (!__this_cpu_read(context_tracking.active))
+		return;
+
 	/* Kernel threads aren't supposed to go to userspace */
 	WARN_ON_ONCE(!current->mm);
 
@@ -73,8 +112,8 @@ void user_enter(void)
 
 
 /**
- * user_exit - Inform the context tracking that the CPU is
- *             exiting userspace mode and entering the kernel.
+ * context_tracking_user_exit - Inform the context tracking that the CPU is
+ *                              exiting userspace mode and entering the kernel.
  *
  * This function must be called after we entered the kernel from userspace
  * before any use of RCU read side critical section. This potentially include
@@ -83,7 +122,7 @@ void user_enter(void)
  * This call supports re-entrancy. This way it can be called from any exception
  * handler without needing to know if we came from userspace or not.
  */
-void user_exit(void)
+void context_tracking_user_exit(void)
 {
 	unsigned long flags;
 
@@ -123,7 +162,7 @@ EXPORT_SYMBOL_GPL(guest_exit);
 
 
 /**
- * context_tracking_task_switch - context switch the syscall callbacks
+ * __context_tracking_task_switch - context switch the syscall callbacks
  * @prev: the task that is being switched out
  * @next: the task that is being switched in
  *
@@ -135,8 +174,8 @@ EXPORT_SYMBOL_GPL(guest_exit);
  * migrate to some CPU that doesn't do the context tracking. As such the TIF
  * flag may not be desired there.
  */
-void context_tracking_task_switch(struct task_struct *prev,
-			     struct task_struct *next)
+void __context_tracking_task_switch(struct task_struct *prev,
+				    struct task_struct *next)
 {
 	if (__this_cpu_read(context_tracking.active)) {
 		clear_tsk_thread_flag(prev, TIF_NOHZ);
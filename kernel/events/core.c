@@ -37,6 +37,7 @@
 #include <linux/ftrace_event.h>
 #include <linux/hw_breakpoint.h>
 #include <linux/mm_types.h>
+#include <linux/tick.h>
 
 #include "internal.h"
 
@@ -655,8 +656,14 @@ static void perf_pmu_rotate_start(struct pmu *pmu)
 
 	WARN_ON(!irqs_disabled());
 
-	if (list_empty(&cpuctx->rotation_list))
+	if (list_empty(&cpuctx->rotation_list)) {
+		int was_empty = list_empty(head);
 		list_add(&cpuctx->rotation_list, head);
+		/* Rotation and frequency adjustment are driven by the tick */
+		if (was_empty)
+			tick_dep_set_cpu(smp_processor_id(),
+					 TICK_DEP_BIT_PERF_EVENTS);
+	}
 }
 
 static void get_ctx(struct perf_event_context *ctx)
@@ -2551,8 +2558,12 @@ static void perf_rotate_context(struct perf_cpu_context *cpuctx)
 	perf_pmu_enable(cpuctx->ctx.pmu);
 	perf_ctx_unlock(cpuctx, cpuctx->task_ctx);
 done:
-	if (remove)
+	if (remove) {
 		list_del_init(&cpuctx->rotation_list);
+		if (list_empty(&__get_cpu_var(rotation_list)))
+			tick_dep_clear_cpu(smp_processor_id(),
+					   TICK_DEP_BIT_PERF_EVENTS);
+	}
 }
 
 void perf_event_task_tick(void)
@@ -2871,6 +2882,7 @@ static void ring_buffer_put(struct ring_buffer *rb);
 static void free_event(struct perf_event *event)
 {
 	irq_work_sync(&event->pending);
+	irq_work_sync(&event->pending_wakeup_work);
 
 	if (!event->parent) {
 		if (event->attach_state & PERF_ATTACH_TASK)
@@ -3749,6 +3761,21 @@ static void perf_pending_event(struct irq_work *entry)
 	}
 }
 
+/*
+ * Ring buffer wakeups don't need to be immediate, they are batched to
+ * the next interrupt.
+ */
+static void perf_pending_wakeup(struct irq_work *entry)
+{
+	struct perf_event *event = container_of(entry,
+			struct perf_event, pending_wakeup_work);
+
+	if (event->pending_wakeup) {
+		event->pending_wakeup = 0;
+		perf_event_wakeup(event);
+	}
+}
+
 /*
  * We assume there is only KVM supporting the callbacks.
  * Later on, we might change it to a list if there is
@@ -6146,6 +6173,7 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 
 	init_waitqueue_head(&event->waitq);
 	init_irq_work(&event->pending, perf_pending_event);
+	init_irq_work_lazy(&event->pending_wakeup_work, perf_pending_wakeup);
 
 	mutex_init(&event->mmap_mutex);
 
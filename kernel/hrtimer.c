@@ -161,10 +161,10 @@ struct hrtimer_clock_base *lock_hrtimer_base(const struct hrtimer *timer,
 static int hrtimer_get_target(int this_cpu, int pinned)
 {
 #ifdef CONFIG_NO_HZ
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(this_cpu))
-		return get_nohz_timer_target();
-#endif
+	return get_nohz_timer_target(pinned);
+#else
 	return this_cpu;
+#endif
 }
 
 /*
@@ -527,6 +527,12 @@ static inline int hrtimer_hres_active(void)
 /*
  * Reprogram the event source with checking both queues for the
  * next event
+ *
+ * With skip_equal set, the reprogramming is skipped when the event
+ * source is already armed for a time which serves the next timer:
+ * inside its [softexpires, expires] slack range, the timer is run by
+ * the pending interrupt.
+ *
  * Called with interrupts disabled and base->lock held
  */
 static void
@@ -534,9 +540,10 @@ hrtimer_force_reprogram(struct hrtimer_cpu_base *cpu_base, int skip_equal)
 {
 	int i;
 	struct hrtimer_clock_base *base = cpu_base->clock_base;
-	ktime_t expires, expires_next;
+	ktime_t expires, expires_next, softexpires_next;
 
 	expires_next.tv64 = KTIME_MAX;
+	softexpires_next.tv64 = KTIME_MAX;
 
 	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++, base++) {
 		struct hrtimer *timer;
@@ -555,13 +562,30 @@ hrtimer_force_reprogram(struct hrtimer_cpu_base *cpu_base, int skip_equal)
 		 */
 		if (expires.tv64 < 0)
 			expires.tv64 = 0;
-		if (expires.tv64 < expires_next.tv64)
+		if (expires.tv64 < expires_next.tv64) {
 			expires_next = expires;
+			softexpires_next = hrtimer_get_softexpires(timer);
+			softexpires_next = ktime_sub(softexpires_next,
+						     base->offset);
+		}
 	}
 
 	if (skip_equal && expires_next.tv64 == cpu_base->expires_next.tv64)
 		return;
 
+	/*
+	 * The event source is armed earlier than the next timer but not
+	 * before its soft expiry: that timer is grouped into the pending
+	 * interrupt. Don't do it when a hang was detected, the event source
+	 * is then armed later than expires_next.
+	 */
+	if (skip_equal && !cpu_base->hang_detected &&
+	    cpu_base->expires_next.tv64 <= expires_next.tv64 &&
+	    cpu_base->expires_next.tv64 >= softexpires_next.tv64) {
+		cpu_base->nr_reprograms_saved++;
+		return;
+	}
+
 	cpu_base->expires_next.tv64 = expires_next.tv64;
 
 	if (cpu_base->expires_next.tv64 != KTIME_MAX)
@@ -647,6 +671,27 @@ static inline int hrtimer_enqueue_reprogram(struct hrtimer *timer,
 	return base->cpu_base->hres_active && hrtimer_reprogram(timer, base);
 }
 
+/*
+ * Is the event source of this CPU armed for the expiry of @timer ?
+ * Called with base->cpu_base->lock held
+ */
+static inline int hrtimer_armed_for(struct hrtimer *timer,
+				    struct hrtimer_clock_base *base)
+{
+	struct hrtimer_cpu_base *cpu_base = base->cpu_base;
+	ktime_t expires;
+
+	if (!hrtimer_is_queued(timer) || !cpu_base->hres_active ||
+	    cpu_base != &__get_cpu_var(hrtimer_bases))
+		return 0;
+
+	if (timerqueue_getnext(&base->active) != &timer->node)
+		return 0;
+
+	expires = ktime_sub(hrtimer_get_expires(timer), base->offset);
+	return cpu_base->expires_next.tv64 == expires.tv64;
+}
+
 static inline ktime_t hrtimer_update_base(struct hrtimer_cpu_base *base)
 {
 	ktime_t *offs_real = &base->clock_base[HRTIMER_BASE_REALTIME].offset;
@@ -729,6 +774,11 @@ static inline int hrtimer_enqueue_reprogram(struct hrtimer *timer,
 {
 	return 0;
 }
+static inline int hrtimer_armed_for(struct hrtimer *timer,
+				    struct hrtimer_clock_base *base)
+{
+	return 0;
+}
 static inline void hrtimer_init_hres(struct hrtimer_cpu_base *base) { }
 static inline void retrigger_next_event(void *arg) { }
 
@@ -911,9 +961,13 @@ out:
 
 /*
  * remove hrtimer, called with base lock held
+ *
+ * When @restart is set the caller requeues the timer and takes care
+ * of the reprogramming.
  */
 static inline int
-remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
+remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base,
+	       int restart)
 {
 	if (hrtimer_is_queued(timer)) {
 		unsigned long state;
@@ -929,7 +983,8 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
 		 */
 		debug_deactivate(timer);
 		timer_stats_hrtimer_clear_start_info(timer);
-		reprogram = base->cpu_base == &__get_cpu_var(hrtimer_bases);
+		reprogram = !restart &&
+			    base->cpu_base == &__get_cpu_var(hrtimer_bases);
 		/*
 		 * We must preserve the CALLBACK state flag here,
 		 * otherwise we could move the timer base in
@@ -948,15 +1003,28 @@ int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 {
 	struct hrtimer_clock_base *base, *new_base;
 	unsigned long flags;
-	int ret, leftmost;
+	int ret, leftmost, force_local;
 
 	base = lock_hrtimer_base(timer, &flags);
 
+	/*
+	 * Restarting the timer the event source is armed for would
+	 * reprogram it twice: on removal for the next timer, then on
+	 * enqueue. Keep such a timer on this CPU and reprogram once it
+	 * is queued again. Full dynticks CPUs still push it away.
+	 */
+	force_local = hrtimer_armed_for(timer, base) &&
+		      is_housekeeping_cpu(smp_processor_id());
+
 	/* Remove an active timer from the queue: */
-	ret = remove_hrtimer(timer, base);
+	ret = remove_hrtimer(timer, base, force_local);
 
 	/* Switch the timer base, if necessary: */
-	new_base = switch_hrtimer_base(timer, base, mode & HRTIMER_MODE_PINNED);
+	if (force_local)
+		new_base = base;
+	else
+		new_base = switch_hrtimer_base(timer, base,
+					       mode & HRTIMER_MODE_PINNED);
 
 	if (mode & HRTIMER_MODE_REL) {
 		tim = ktime_add_safe(tim, new_base->get_time());
@@ -978,6 +1046,21 @@ int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 
 	leftmost = enqueue_hrtimer(timer, new_base);
 
+	/*
+	 * Account the timers which should have left a full dynticks CPU
+	 * but stay there because their callback is running or because
+	 * they expire before the next event of the housekeeping CPU.
+	 */
+	if (!(mode & HRTIMER_MODE_PINNED) &&
+	    !is_housekeeping_cpu(new_base->cpu_base->cpu))
+		new_base->cpu_base->nr_unmovable++;
+
+	if (force_local) {
+		hrtimer_force_reprogram(new_base->cpu_base, 1);
+		unlock_hrtimer_base(timer, &flags);
+		return ret;
+	}
+
 	/*
 	 * Only allow reprogramming if the new base is on this CPU.
 	 * (it might still be on another CPU if the timer was pending)
@@ -1060,7 +1143,7 @@ int hrtimer_try_to_cancel(struct hrtimer *timer)
 	base = lock_hrtimer_base(timer, &flags);
 
 	if (!hrtimer_callback_running(timer))
-		ret = remove_hrtimer(timer, base);
+		ret = remove_hrtimer(timer, base, 0);
 
 	unlock_hrtimer_base(timer, &flags);
 
@@ -1643,6 +1726,7 @@ static void __cpuinit init_hrtimers_cpu(int cpu)
 	int i;
 
 	raw_spin_lock_init(&cpu_base->lock);
+	cpu_base->cpu = cpu;
 
 	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++) {
 		cpu_base->clock_base[i].cpu_base = cpu_base;
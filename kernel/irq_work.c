@@ -16,10 +16,19 @@
 #include <linux/tick.h>
 #include <linux/cpu.h>
 #include <linux/notifier.h>
+#include <linux/smp.h>
 #include <asm/processor.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/irq_work.h>
 
-static DEFINE_PER_CPU(struct llist_head, irq_work_list);
+/*
+ * Urgent works raise the irq work interrupt. Lazy works wait for the
+ * next natural interrupt instead: the tick, or when the tick is stopped,
+ * the exit of any interrupt.
+ */
+static DEFINE_PER_CPU(struct llist_head, raised_list);
+static DEFINE_PER_CPU(struct llist_head, lazy_list);
 static DEFINE_PER_CPU(int, irq_work_raised);
 
 /*
@@ -55,6 +64,21 @@ void __weak arch_irq_work_raise(void)
 	 */
 }
 
+/*
+ * Does arch_irq_work_raise() trigger an interrupt? Lame architectures
+ * keep the tick alive while urgent works are pending.
+ */
+bool __weak arch_irq_work_has_interrupt(void)
+{
+	return false;
+}
+
+static void irq_work_raise(void)
+{
+	if (!this_cpu_cmpxchg(irq_work_raised, 0, 1))
+		arch_irq_work_raise();
+}
+
 /*
  * Enqueue the irq_work @entry unless it's already pending
  * somewhere.
@@ -70,29 +94,72 @@ void irq_work_queue(struct irq_work *work)
 	/* Queue the entry and raise the IPI if needed. */
 	preempt_disable();
 
-	llist_add(&work->llnode, &__get_cpu_var(irq_work_list));
+	trace_irq_work_queue(work, smp_processor_id());
 
-	/*
-	 * If the work is not "lazy" or the tick is stopped, raise the irq
-	 * work interrupt (if supported by the arch), otherwise, just wait
-	 * for the next tick.
-	 */
-	if (!(work->flags & IRQ_WORK_LAZY) || tick_nohz_tick_stopped()) {
-		if (!this_cpu_cmpxchg(irq_work_raised, 0, 1))
-			arch_irq_work_raise();
+	if (work->flags & IRQ_WORK_LAZY) {
+		llist_add(&work->llnode, &__get_cpu_var(lazy_list));
+		/*
+		 * With the tick stopped, lazy works are run on the exit of
+		 * the interrupt we are in, if any. Otherwise there may be
+		 * no natural interrupt for a while, so raise one.
+		 */
+		if (tick_nohz_tick_stopped() && (!in_irq() || in_nmi()))
+			irq_work_raise();
+	} else {
+		llist_add(&work->llnode, &__get_cpu_var(raised_list));
+		irq_work_raise();
 	}
 
 	preempt_enable();
 }
 EXPORT_SYMBOL_GPL(irq_work_queue);
 
+#ifdef CONFIG_SMP
+/*
+ * Enqueue the irq_work @work on @cpu unless it's already pending
+ * somewhere. The work is run from the generic smp call function
+ * single interrupt on the target.
+ *
+ * Can be re-enqueued while the callback is still in progress.
+ */
+bool irq_work_queue_on(struct irq_work *work, int cpu)
+{
+	/* All work should have been flushed before going offline */
+	WARN_ON_ONCE(cpu_is_offline(cpu));
+
+	/* Arch remote IPI send/receive backend aren't NMI safe */
+	WARN_ON_ONCE(in_nmi());
+
+	/* Only queue if not already pending */
+	if (!irq_work_claim(work))
+		return false;
+
+	trace_irq_work_queue(work, cpu);
+
+	llist_add(&work->llnode, &per_cpu(raised_list, cpu));
+	arch_send_call_function_single_ipi(cpu);
+
+	return true;
+}
+EXPORT_SYMBOL_GPL(irq_work_queue_on);
+#endif
+
+/*
+ * Called before the tick is stopped. Pending works only keep it alive on
+ * lame archs, elsewhere the lazy ones stay queued and get an interrupt
+ * raised so that they don't wait for the tick to be restarted.
+ */
 bool irq_work_needs_cpu(void)
 {
-	struct llist_head *this_list;
+	if (llist_empty(&__get_cpu_var(raised_list)) &&
+	    llist_empty(&__get_cpu_var(lazy_list)))
+		return false;
 
-	this_list = &__get_cpu_var(irq_work_list);
-	if (llist_empty(this_list))
+	if (arch_irq_work_has_interrupt()) {
+		if (!llist_empty(&__get_cpu_var(lazy_list)))
+			irq_work_raise();
 		return false;
+	}
 
 	/* All work should have been flushed before going offline */
 	WARN_ON_ONCE(cpu_is_offline(smp_processor_id()));
@@ -100,22 +167,12 @@ bool irq_work_needs_cpu(void)
 	return true;
 }
 
-static void __irq_work_run(void)
+static void irq_work_run_list(struct llist_head *this_list)
 {
 	unsigned long flags;
 	struct irq_work *work;
-	struct llist_head *this_list;
 	struct llist_node *llnode;
 
-
-	/*
-	 * Reset the "raised" state right before we check the list because
-	 * an NMI may enqueue after we find the list empty from the runner.
-	 */
-	__this_cpu_write(irq_work_raised, 0);
-	barrier();
-
-	this_list = &__get_cpu_var(irq_work_list);
 	if (llist_empty(this_list))
 		return;
 
@@ -137,7 +194,9 @@ static void __irq_work_run(void)
 		flags = work->flags & ~IRQ_WORK_PENDING;
 		xchg(&work->flags, flags);
 
+		trace_irq_work_entry(work);
 		work->func(work);
+		trace_irq_work_exit(work);
 		/*
 		 * Clear the BUSY bit and return to the free state if
 		 * no-one else claimed it meanwhile.
@@ -146,17 +205,43 @@ static void __irq_work_run(void)
 	}
 }
 
+static void __irq_work_run(void)
+{
+	/*
+	 * Reset the "raised" state right before we check the list because
+	 * an NMI may enqueue after we find the list empty from the runner.
+	 */
+	__this_cpu_write(irq_work_raised, 0);
+	barrier();
+
+	irq_work_run_list(&__get_cpu_var(raised_list));
+	/* Any interrupt is a good occasion for the lazy works */
+	irq_work_run_list(&__get_cpu_var(lazy_list));
+}
+
 /*
  * Run the irq_work entries on this cpu. Requires to be ran from hardirq
- * context with local IRQs disabled.
+ * context with local IRQs disabled. Not all archs enter the irq context
+ * before the generic smp function interrupt, so only irqs disabled is
+ * enforced.
  */
 void irq_work_run(void)
 {
-	BUG_ON(!in_irq());
+	BUG_ON(!irqs_disabled());
 	__irq_work_run();
 }
 EXPORT_SYMBOL_GPL(irq_work_run);
 
+/*
+ * Run the lazy irq_work entries on this cpu while its tick is stopped.
+ * Called from interrupt exit, with local IRQs disabled.
+ */
+void irq_work_run_lazy(void)
+{
+	BUG_ON(!irqs_disabled());
+	irq_work_run_list(&__get_cpu_var(lazy_list));
+}
+
 /*
  * Synchronize against the irq_work @entry, ensures the entry is not
  * currently in use.
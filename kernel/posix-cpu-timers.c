@@ -10,6 +10,8 @@
 #include <linux/kernel_stat.h>
 #include <trace/events/timer.h>
 #include <linux/random.h>
+#include <linux/hrtimer.h>
+#include <linux/irq_work.h>
 
 /*
  * Called after updating RLIMIT_CPU to run cpu timer and update
@@ -512,6 +514,8 @@ static void clear_dead_task(struct k_itimer *timer, union cpu_time_count now)
 					     now);
 }
 
+static void posix_cpu_timers_kick_group(struct task_struct *tsk);
+
 static inline int expires_gt(cputime_t expires, cputime_t new_exp)
 {
 	return expires == 0 || expires > new_exp;
@@ -572,6 +576,12 @@ static void arm_timer(struct k_itimer *timer)
 				cputime_expires->sched_exp = exp->sched;
 			break;
 		}
+
+		/* Reprogram the CPUs running the new earliest timer owner */
+		if (CPUCLOCK_PERTHREAD(timer->it_clock))
+			posix_cpu_timers_kick(p);
+		else
+			posix_cpu_timers_kick_group(p);
 	}
 }
 
@@ -877,6 +887,21 @@ static void posix_cpu_timer_get(struct k_itimer *timer, struct itimerspec *itp)
 	}
 }
 
+/**
+ * task_cputime_zero - Check a task_cputime struct for all zero fields.
+ *
+ * @cputime:	The struct to compare.
+ *
+ * Checks @cputime to see if all fields are zero.  Returns true if all fields
+ * are zero, false if any field is nonzero.
+ */
+static inline int task_cputime_zero(const struct task_cputime *cputime)
+{
+	if (!cputime->utime && !cputime->stime && !cputime->sum_exec_runtime)
+		return 1;
+	return 0;
+}
+
 /*
  * Check for any per-thread CPU timers that have fired and move them off
  * the tsk->cpu_timers[N] list onto the firing list.  Here we update the
@@ -1008,21 +1033,6 @@ static void check_cpu_itimer(struct task_struct *tsk, struct cpu_itimer *it,
 	}
 }
 
-/**
- * task_cputime_zero - Check a task_cputime struct for all zero fields.
- *
- * @cputime:	The struct to compare.
- *
- * Checks @cputime to see if all fields are zero.  Returns true if all fields
- * are zero, false if any field is nonzero.
- */
-static inline int task_cputime_zero(const struct task_cputime *cputime)
-{
-	if (!cputime->utime && !cputime->stime && !cputime->sum_exec_runtime)
-		return 1;
-	return 0;
-}
-
 /*
  * Check for any per-thread CPU timers that have fired and move them
  * off the tsk->*_timers list onto the firing list.  Per-thread timers
@@ -1270,9 +1280,9 @@ static inline int fastpath_timer_check(struct task_struct *tsk)
 }
 
 /*
- * This is called from the timer interrupt handler.  The irq handler has
- * already updated our counts.  We need to check if any timers fire now.
- * Interrupts are disabled.
+ * This is called from the CPU timers hrtimer below, after the runtime of
+ * the current task has been updated.  We need to check if any timers fire
+ * now.  Interrupts are disabled.
  */
 void run_posix_cpu_timers(struct task_struct *tsk)
 {
@@ -1338,6 +1348,232 @@ void run_posix_cpu_timers(struct task_struct *tsk)
 	}
 }
 
+/*
+ * The CPU timers of the current task are elapsed by a per CPU hrtimer
+ * programmed on the remaining budget of its earliest thread or process
+ * timer instead of being polled from every tick.  It is reprogrammed on
+ * context switch and whenever an earlier timer is armed for a running
+ * task.  A thread CPU clock only moves while its task runs and no faster
+ * than walltime, so the hrtimer may fire early but never late for these.
+ * An early fire simply reprograms it on the new remaining budget.
+ */
+static DEFINE_PER_CPU(struct hrtimer, posix_cpu_hrtimer);
+
+static u64 cpu_timer_remaining(cputime_t sample, cputime_t expires)
+{
+	struct timespec ts;
+
+	if (!expires)
+		return ULLONG_MAX;
+	if (sample >= expires)
+		return 0;
+
+	cputime_to_timespec(expires - sample, &ts);
+	/* Tick based cputime only makes progress on ticks */
+	if (!vtime_accounting_enabled())
+		return max_t(u64, timespec_to_ns(&ts), TICK_NSEC);
+
+	return timespec_to_ns(&ts);
+}
+
+static u64 sched_timer_remaining(unsigned long long sample,
+				 unsigned long long expires)
+{
+	if (!expires)
+		return ULLONG_MAX;
+	if (sample >= expires)
+		return 0;
+
+	return expires - sample;
+}
+
+/*
+ * Same as task_cputime_expired() but return the nsecs left before the
+ * earliest expiration in @expires, ULLONG_MAX if there is none.
+ */
+static u64 task_cputime_remaining(const struct task_cputime *sample,
+				  const struct task_cputime *expires)
+{
+	u64 next;
+
+	next = cpu_timer_remaining(sample->utime, expires->utime);
+	next = min(next, cpu_timer_remaining(sample->utime + sample->stime,
+					     expires->stime));
+	next = min(next, sched_timer_remaining(sample->sum_exec_runtime,
+					       expires->sum_exec_runtime));
+
+	return next;
+}
+
+/*
+ * Return the walltime in nsecs the current task @tsk can run before it
+ * may elapse one of its thread or process CPU timers, ULLONG_MAX if it
+ * has none.  Interrupts are disabled.
+ */
+static u64 posix_cpu_timers_next(struct task_struct *tsk)
+{
+	struct signal_struct *sig = tsk->signal;
+	u64 next = ULLONG_MAX;
+
+	if (!task_cputime_zero(&tsk->cputime_expires)) {
+		struct task_cputime task_sample;
+
+		task_cputime(tsk, &task_sample.utime, &task_sample.stime);
+		task_sample.sum_exec_runtime = tsk->se.sum_exec_runtime;
+		next = task_cputime_remaining(&task_sample,
+					      &tsk->cputime_expires);
+	}
+
+	if (sig->cputimer.running) {
+		struct task_cputime group_sample;
+		u64 group_next;
+		int live;
+
+		raw_spin_lock(&sig->cputimer.lock);
+		group_sample = sig->cputimer.cputime;
+		raw_spin_unlock(&sig->cputimer.lock);
+
+		group_next = task_cputime_remaining(&group_sample,
+						    &sig->cputime_expires);
+		/*
+		 * The other threads elapse the process clocks concurrently
+		 * on other CPUs.  Assume the worst and only program our share
+		 * of the budget, but not below a tick, so that the process
+		 * timers aren't missed by far.
+		 */
+		live = atomic_read(&sig->live);
+		if (live > 1 && group_next != ULLONG_MAX &&
+		    group_next > TICK_NSEC) {
+			group_next = max_t(u64, div_u64(group_next, live),
+					   TICK_NSEC);
+		}
+		next = min(next, group_next);
+	}
+
+	return next;
+}
+
+static ktime_t posix_cpu_next_ktime(u64 next)
+{
+	return ns_to_ktime(min_t(u64, next, KTIME_MAX));
+}
+
+/*
+ * Program the hrtimer of this CPU on the next CPU timer expiry of the
+ * current task, or cancel it if there is none.  Interrupts are disabled.
+ */
+static void posix_cpu_timers_rearm(void)
+{
+	struct hrtimer *hrtimer = &__get_cpu_var(posix_cpu_hrtimer);
+	u64 next = posix_cpu_timers_next(current);
+
+	if (next == ULLONG_MAX) {
+		if (hrtimer_active(hrtimer))
+			hrtimer_try_to_cancel(hrtimer);
+		return;
+	}
+
+	hrtimer_start(hrtimer, posix_cpu_next_ktime(next),
+		      HRTIMER_MODE_REL_PINNED);
+}
+
+static enum hrtimer_restart posix_cpu_hrtimer_fn(struct hrtimer *hrtimer)
+{
+	u64 next;
+
+	sched_update_curr_runtime();
+	run_posix_cpu_timers(current);
+
+	next = posix_cpu_timers_next(current);
+	if (next == ULLONG_MAX)
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(hrtimer, posix_cpu_next_ktime(next));
+
+	return HRTIMER_RESTART;
+}
+
+static void posix_cpu_kick_func(struct irq_work *work)
+{
+	sched_update_curr_runtime();
+	posix_cpu_timers_rearm();
+}
+
+static DEFINE_PER_CPU(struct irq_work, posix_cpu_kick_work) = {
+	.func = posix_cpu_kick_func,
+};
+
+/*
+ * Reprogram the hrtimer of @cpu on the expiry cache of the task it runs.
+ */
+void posix_cpu_timers_kick_cpu(int cpu)
+{
+	preempt_disable();
+	if (cpu == smp_processor_id()) {
+		irq_work_queue(&__get_cpu_var(posix_cpu_kick_work));
+	} else {
+#ifdef CONFIG_SMP
+		irq_work_queue_on(&per_cpu(posix_cpu_kick_work, cpu), cpu);
+#endif
+	}
+	preempt_enable();
+}
+
+/*
+ * The expiry cache of @tsk moved earlier: reprogram the hrtimer of the
+ * CPU it runs on.  A task that isn't running picks up the new expiry on
+ * its next context switch.
+ */
+void posix_cpu_timers_kick(struct task_struct *tsk)
+{
+	int cpu;
+
+	preempt_disable();
+	/*
+	 * The rq lock orders the expiry cache store against the switch to
+	 * @tsk, which reads it after releasing that lock: either we see
+	 * @tsk running and kick its CPU, or the switch sees the new expiry.
+	 */
+	if (tsk == current)
+		cpu = smp_processor_id();
+	else
+		cpu = task_curr_cpu(tsk);
+	if (cpu >= 0)
+		posix_cpu_timers_kick_cpu(cpu);
+	preempt_enable();
+}
+
+/*
+ * Same as posix_cpu_timers_kick() for the process timers of the thread
+ * group of @tsk.  The siglock must be held.
+ */
+static void posix_cpu_timers_kick_group(struct task_struct *tsk)
+{
+	struct task_struct *t = tsk;
+
+	do {
+		posix_cpu_timers_kick(t);
+	} while_each_thread(tsk, t);
+}
+
+/*
+ * Called on context switch to program the hrtimer of this CPU for the
+ * incoming task @tsk, or to cancel it if @tsk has no CPU timers.
+ */
+void posix_cpu_timers_task_switch(struct task_struct *tsk)
+{
+	unsigned long flags;
+
+	if (task_cputime_zero(&tsk->cputime_expires) &&
+	    !tsk->signal->cputimer.running &&
+	    !hrtimer_active(&__get_cpu_var(posix_cpu_hrtimer)))
+		return;
+
+	local_irq_save(flags);
+	posix_cpu_timers_rearm();
+	local_irq_restore(flags);
+}
+
 /*
  * Set one of the process-wide special case CPU timers or RLIMIT_CPU.
  * The tsk->sighand->siglock must be held by the caller.
@@ -1384,6 +1620,9 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 		break;
 	}
+
+	if (*newval)
+		posix_cpu_timers_kick_group(tsk);
 }
 
 static int do_cpu_nanosleep(const clockid_t which_clock, int flags,
@@ -1605,6 +1844,14 @@ static __init int init_posix_cpu_timers(void)
 		.timer_create	= thread_cpu_timer_create,
 	};
 	struct timespec ts;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct hrtimer *hrtimer = &per_cpu(posix_cpu_hrtimer, cpu);
+
+		hrtimer_init(hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		hrtimer->function = posix_cpu_hrtimer_fn;
+	}
 
 	posix_timers_register_clock(CLOCK_PROCESS_CPUTIME_ID, &process);
 	posix_timers_register_clock(CLOCK_THREAD_CPUTIME_ID, &thread);
@@ -51,8 +51,9 @@
 #include <linux/kthread.h>
 #include <linux/prefetch.h>
 #include <linux/delay.h>
-#include <linux/stop_machine.h>
 #include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
 
 #include "rcutree.h"
 #include <trace/events/rcu.h>
@@ -75,6 +76,7 @@ static struct lock_class_key rcu_fqs_class[RCU_NUM_LVLS];
 	.orphan_donetail = &sname##_state.orphan_donelist, \
 	.barrier_mutex = __MUTEX_INITIALIZER(sname##_state.barrier_mutex), \
 	.onoff_mutex = __MUTEX_INITIALIZER(sname##_state.onoff_mutex), \
+	.expedited_mutex = __MUTEX_INITIALIZER(sname##_state.expedited_mutex), \
 	.name = #sname, \
 }
 
@@ -143,6 +145,7 @@ DEFINE_PER_CPU(char, rcu_cpu_has_work);
 static void rcu_boost_kthread_setaffinity(struct rcu_node *rnp, int outgoingcpu);
 static void invoke_rcu_core(void);
 static void invoke_rcu_callbacks(struct rcu_state *rsp, struct rcu_data *rdp);
+static void rcu_sched_exp_qs(int cpu);
 
 /*
  * Track the rcutorture test sequence number and the update version
@@ -200,6 +203,7 @@ void rcu_note_context_switch(int cpu)
 	trace_rcu_utilization("Start context switch");
 	rcu_sched_qs(cpu);
 	rcu_preempt_note_context_switch(cpu);
+	rcu_sched_exp_qs(cpu);
 	trace_rcu_utilization("End context switch");
 }
 EXPORT_SYMBOL_GPL(rcu_note_context_switch);
@@ -217,6 +221,10 @@ module_param(blimit, long, 0444);
 module_param(qhimark, long, 0444);
 module_param(qlowmark, long, 0444);
 
+/* Time after which rcu_do_batch() leaves the softirq (microseconds). */
+static long softirq_budget_us = 2000;
+module_param(softirq_budget_us, long, 0644);
+
 static ulong jiffies_till_first_fqs = RCU_JIFFIES_TILL_FORCE_QS;
 static ulong jiffies_till_next_fqs = RCU_JIFFIES_TILL_FORCE_QS;
 
@@ -1874,15 +1882,42 @@ static void rcu_cleanup_dead_cpu(int cpu, struct rcu_state *rsp)
 
 #endif /* #else #ifdef CONFIG_HOTPLUG_CPU */
 
+/*
+ * Size the next batch of callbacks: at least as many as arrived since
+ * the previous batch, so that a steady stream of callbacks does not
+ * pile up, but no more than the measured per-callback cost lets fit in
+ * the softirq time budget.  No limit during a flood, the time budget
+ * then cuts the batch short.
+ */
+static long rcu_batch_limit(struct rcu_data *rdp)
+{
+	long arrived = rdp->n_cbs_queued - rdp->n_cbs_queued_snap;
+	long bl;
+
+	rdp->n_cbs_queued_snap = rdp->n_cbs_queued;
+	if (rdp->cb_flood)
+		return LONG_MAX;
+	bl = max(blimit, arrived);
+	if (rdp->cb_avg_ns)
+		bl = min(bl, max(blimit, (long)(softirq_budget_us *
+						NSEC_PER_USEC /
+						rdp->cb_avg_ns)));
+	return bl;
+}
+
 /*
  * Invoke any RCU callbacks that have made it to the end of their grace
- * period.  Thottle as specified by rdp->blimit.
+ * period.  Thottle as specified by rdp->blimit, and by the softirq time
+ * budget unless running from the per-CPU kthread.
  */
 static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 {
 	unsigned long flags;
 	struct rcu_head *next, *list, **tail;
 	long bl, count, count_lazy;
+	bool kthread = rcu_is_callbacks_kthread();
+	bool overrun = false;
+	u64 budget, start;
 	int i;
 
 	/* If no callbacks are ready, just return. */
@@ -1900,7 +1935,7 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	 */
 	local_irq_save(flags);
 	WARN_ON_ONCE(cpu_is_offline(smp_processor_id()));
-	bl = rdp->blimit;
+	bl = rdp->blimit = rcu_batch_limit(rdp);
 	trace_rcu_batch_start(rsp->name, rdp->qlen_lazy, rdp->qlen, bl);
 	list = rdp->nxtlist;
 	rdp->nxtlist = *rdp->nxttail[RCU_DONE_TAIL];
@@ -1913,6 +1948,8 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 
 	/* Invoke callbacks. */
 	count = count_lazy = 0;
+	budget = (u64)softirq_budget_us * NSEC_PER_USEC;
+	start = local_clock();
 	while (list) {
 		next = list->next;
 		prefetch(next);
@@ -1923,8 +1960,23 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 		/* Stop only if limit reached and CPU has something to do. */
 		if (++count >= bl &&
 		    (need_resched() ||
-		     (!is_idle_task(current) && !rcu_is_callbacks_kthread())))
+		     (!is_idle_task(current) && !kthread)))
 			break;
+		/* Don't hog the softirq, leave the rest to the kthread. */
+		if (!kthread && !(count & 0xf) &&
+		    local_clock() - start > budget) {
+			overrun = true;
+			break;
+		}
+	}
+
+	/* Track the cost of a callback to size the next batches. */
+	if (count) {
+		unsigned long ns = div64_u64(local_clock() - start, count);
+
+		if (rdp->cb_avg_ns)
+			ns = (rdp->cb_avg_ns * 7 + ns) / 8;
+		rdp->cb_avg_ns = ns ? ns : 1;
 	}
 
 	local_irq_save(flags);
@@ -1948,8 +2000,16 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	rdp->n_cbs_invoked += count;
 
 	/* Reinstate batch limit if we have worked down the excess. */
-	if (rdp->blimit == LONG_MAX && rdp->qlen <= qlowmark)
-		rdp->blimit = blimit;
+	if (rdp->cb_flood && rdp->qlen <= qlowmark) {
+		rdp->cb_flood = false;
+		rdp->cb_offloaded = false;
+	}
+
+	/* Give the callbacks back to the softirq once the kthread is done. */
+	if (kthread && !list)
+		rdp->cb_offloaded = false;
+	if (overrun)
+		rdp->n_batch_overruns++;
 
 	/* Reset ->qlen_last_fqs_check trigger if enough CBs have drained. */
 	if (rdp->qlen == 0 && rdp->qlen_last_fqs_check != 0) {
@@ -1962,7 +2022,8 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	local_irq_restore(flags);
 
 	/* Re-invoke RCU core processing if there are callbacks remaining. */
-	if (cpu_has_callbacks_ready_to_invoke(rdp))
+	if (cpu_has_callbacks_ready_to_invoke(rdp) &&
+	    (!overrun || !rcu_offload_callbacks_kthread(rdp)))
 		invoke_rcu_core();
 }
 
@@ -1994,6 +2055,7 @@ void rcu_check_callbacks(int cpu, int user)
 		 */
 
 		rcu_sched_qs(cpu);
+		rcu_sched_exp_qs(cpu);
 		rcu_bh_qs(cpu);
 
 	} else if (!in_softirq()) {
@@ -2151,16 +2213,17 @@ static void rcu_process_callbacks(struct softirq_action *unused)
 
 /*
  * Schedule RCU callback invocation.  If the specified type of RCU
- * does not support RCU priority boosting, just do a direct call,
- * otherwise wake up the per-CPU kernel kthread.  Note that because we
- * are running on the current CPU with interrupts disabled, the
- * rcu_cpu_kthread_task cannot disappear out from under us.
+ * does not support RCU priority boosting and its callbacks were not
+ * offloaded because of a flood, just do a direct call, otherwise wake
+ * up the per-CPU kernel kthread.  Note that because we are running on
+ * the current CPU with interrupts disabled, the rcu_cpu_kthread_task
+ * cannot disappear out from under us.
  */
 static void invoke_rcu_callbacks(struct rcu_state *rsp, struct rcu_data *rdp)
 {
 	if (unlikely(!ACCESS_ONCE(rcu_scheduler_fully_active)))
 		return;
-	if (likely(!rsp->boost)) {
+	if (likely(!rsp->boost) && likely(!rdp->cb_offloaded)) {
 		rcu_do_batch(rsp, rdp);
 		return;
 	}
@@ -2211,7 +2274,10 @@ static void __call_rcu_core(struct rcu_state *rsp, struct rcu_data *rdp,
 			rcu_start_gp(rsp, nestflag);  /* rlses rnp_root->lock */
 		} else {
 			/* Give the grace period a kick. */
-			rdp->blimit = LONG_MAX;
+			if (!rdp->cb_flood) {
+				rdp->cb_flood = true;
+				rdp->n_cb_floods++;
+			}
 			if (rsp->n_force_qs == rdp->n_force_qs_snap &&
 			    *rdp->nxttail[RCU_DONE_TAIL] != head)
 				force_quiescent_state(rsp);
@@ -2261,6 +2327,9 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 		return;
 	}
 	ACCESS_ONCE(rdp->qlen)++;
+	rdp->n_cbs_queued++;
+	if (rdp->qlen > rdp->qlen_max)
+		rdp->qlen_max = rdp->qlen;
 	if (lazy)
 		rdp->qlen_lazy++;
 	else
@@ -2298,6 +2367,165 @@ void call_rcu_bh(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 }
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
+/*
+ * kfree_rcu() batching.  Rather than queueing one callback per object,
+ * kfree_call_rcu() collects the pointers to free in per-CPU page-sized
+ * arrays, each of them waiting for a grace period as a single callback
+ * which frees the whole array.  This avoids walking a callback list with
+ * a cache miss per object.  A partially filled array is submitted after
+ * KFREE_DRAIN_JIFFIES at most.  When no array can be allocated, the
+ * objects fall back to their own callbacks.
+ *
+ * Full dynticks CPUs don't batch, the drain timer would interrupt them
+ * every KFREE_DRAIN_JIFFIES.  rcu_barrier() submits all the arrays before
+ * entraining its own callbacks, so that kfree_rcu() followed by
+ * rcu_barrier() still guarantees the objects are freed, eg: before a
+ * module destroys the cache they were allocated from.
+ */
+#define KFREE_DRAIN_JIFFIES	(HZ / 50 ?: 1)
+
+struct kfree_rcu_bulk {
+	struct rcu_head rcu_head;
+	struct rcu_state *rsp;
+	unsigned long nr_records;
+	void *records[];
+};
+
+#define KFREE_BULK_MAX_ENTRIES \
+	((PAGE_SIZE - sizeof(struct kfree_rcu_bulk)) / sizeof(void *))
+
+struct kfree_rcu_cpu {
+	raw_spinlock_t lock;
+	struct kfree_rcu_bulk *bulk;	/* Array being filled. */
+	struct timer_list timer;	/* Submits a partial array. */
+};
+
+static DEFINE_PER_CPU(struct kfree_rcu_cpu, kfree_rcu_cpu);
+
+static void kfree_rcu_bulk_free(struct rcu_head *rhp)
+{
+	struct kfree_rcu_bulk *bulk;
+	unsigned long i;
+
+	bulk = container_of(rhp, struct kfree_rcu_bulk, rcu_head);
+	for (i = 0; i < bulk->nr_records; i++)
+		kfree(bulk->records[i]);
+	free_page((unsigned long)bulk);
+}
+
+/*
+ * Hand the array being filled on @krcp over to RCU.  Called with
+ * krcp->lock held.
+ */
+static void kfree_rcu_submit(struct kfree_rcu_cpu *krcp)
+{
+	struct kfree_rcu_bulk *bulk = krcp->bulk;
+
+	if (!bulk)
+		return;
+	krcp->bulk = NULL;
+	__call_rcu(&bulk->rcu_head, kfree_rcu_bulk_free, bulk->rsp, -1, 0);
+}
+
+static void kfree_rcu_drain(unsigned long data)
+{
+	struct kfree_rcu_cpu *krcp = &per_cpu(kfree_rcu_cpu, data);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&krcp->lock, flags);
+	kfree_rcu_submit(krcp);
+	raw_spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/*
+ * Queue the object embedding @head for kfree() after an RCU grace
+ * period of @rsp, in the array of the current CPU if possible.
+ */
+static void kfree_rcu_batch(struct rcu_head *head,
+			    void (*func)(struct rcu_head *rcu),
+			    struct rcu_state *rsp)
+{
+	struct kfree_rcu_cpu *krcp;
+	struct kfree_rcu_bulk *bulk;
+	unsigned long flags;
+
+	/* Timers and page allocator may not be ready yet. */
+	if (!rcu_scheduler_fully_active)
+		goto fallback;
+
+	local_irq_save(flags);
+	if (tick_nohz_full_cpu(smp_processor_id())) {
+		local_irq_restore(flags);
+		goto fallback;
+	}
+	krcp = &__get_cpu_var(kfree_rcu_cpu);
+	raw_spin_lock(&krcp->lock);
+	bulk = krcp->bulk;
+	if (!bulk) {
+		bulk = (struct kfree_rcu_bulk *)
+			__get_free_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!bulk) {
+			raw_spin_unlock_irqrestore(&krcp->lock, flags);
+			goto fallback;
+		}
+		bulk->rsp = rsp;
+		bulk->nr_records = 0;
+		krcp->bulk = bulk;
+		mod_timer_pinned(&krcp->timer, jiffies + KFREE_DRAIN_JIFFIES);
+	}
+	WARN_ON_ONCE(bulk->rsp != rsp);
+	bulk->records[bulk->nr_records++] = (void *)head - (unsigned long)func;
+	if (bulk->nr_records == KFREE_BULK_MAX_ENTRIES)
+		kfree_rcu_submit(krcp);
+	raw_spin_unlock_irqrestore(&krcp->lock, flags);
+	return;
+
+fallback:
+	__call_rcu(head, func, rsp, -1, 1);
+}
+
+/*
+ * Submit the array left by an offline CPU.
+ */
+static void kfree_rcu_cleanup_dead_cpu(int cpu)
+{
+	struct kfree_rcu_cpu *krcp = &per_cpu(kfree_rcu_cpu, cpu);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&krcp->lock, flags);
+	kfree_rcu_submit(krcp);
+	raw_spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/*
+ * Submit the arrays of all CPUs, for _rcu_barrier() to wait for them.
+ */
+static void kfree_rcu_submit_all(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = &per_cpu(kfree_rcu_cpu, cpu);
+		unsigned long flags;
+
+		raw_spin_lock_irqsave(&krcp->lock, flags);
+		kfree_rcu_submit(krcp);
+		raw_spin_unlock_irqrestore(&krcp->lock, flags);
+	}
+}
+
+static void __init kfree_rcu_batch_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = &per_cpu(kfree_rcu_cpu, cpu);
+
+		raw_spin_lock_init(&krcp->lock);
+		setup_timer(&krcp->timer, kfree_rcu_drain, cpu);
+	}
+}
+
 /*
  * Because a context switch is a grace period for RCU-sched and RCU-bh,
  * any blocking grace-period wait automatically implies a grace period
@@ -2401,21 +2629,165 @@ void synchronize_rcu_bh(void)
 }
 EXPORT_SYMBOL_GPL(synchronize_rcu_bh);
 
-static int synchronize_sched_expedited_cpu_stop(void *data)
+/*
+ * Report an expedited RCU-sched quiescent state for the groups in @mask
+ * of the rcu_node structure @rnp, propagating it up the rcu_node tree as
+ * the groups complete.  Wake up the expedited grace period once the root
+ * is reached.  The caller must hold rnp->lock with irqs disabled, this
+ * lock is released.
+ */
+static void rcu_report_exp_sched_rnp(struct rcu_state *rsp,
+				     struct rcu_node *rnp, unsigned long mask,
+				     unsigned long flags)
+	__releases(rnp->lock)
 {
-	/*
-	 * There must be a full memory barrier on each affected CPU
-	 * between the time that try_stop_cpus() is called and the
-	 * time that it returns.
-	 *
-	 * In the current initial implementation of cpu_stop, the
-	 * above condition is already met when the control reaches
-	 * this point and the following smp_mb() is not strictly
-	 * necessary.  Do smp_mb() anyway for documentation and
-	 * robustness against future implementation changes.
-	 */
-	smp_mb(); /* See above comment block. */
-	return 0;
+	for (;;) {
+		rnp->expmask_sched &= ~mask;
+		if (rnp->expmask_sched) {
+			raw_spin_unlock_irqrestore(&rnp->lock, flags);
+			return;
+		}
+		if (!rnp->parent)
+			break;
+		mask = rnp->grpmask;
+		raw_spin_unlock(&rnp->lock); /* irqs remain disabled */
+		rnp = rnp->parent;
+		raw_spin_lock(&rnp->lock); /* irqs already disabled */
+	}
+	raw_spin_unlock_irqrestore(&rnp->lock, flags);
+	wake_up(&rsp->expedited_wq);
+}
+
+/*
+ * Report an expedited RCU-sched quiescent state for the specified CPU,
+ * if the current expedited grace period still waits for it.
+ */
+static void rcu_report_exp_sched_rdp(struct rcu_state *rsp,
+				     struct rcu_data *rdp)
+{
+	unsigned long flags;
+	struct rcu_node *rnp = rdp->mynode;
+
+	rdp->exp_qs_pending = false;
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	if (!(rnp->expmask_sched & rdp->grpmask)) {
+		raw_spin_unlock_irqrestore(&rnp->lock, flags);
+		return;
+	}
+	rcu_report_exp_sched_rnp(rsp, rnp, rdp->grpmask, flags);
+}
+
+/*
+ * Note a context switch or an interrupt from user mode or idle on the
+ * specified CPU, which is a quiescent state for an expedited RCU-sched
+ * grace period that asked for it.
+ */
+static void rcu_sched_exp_qs(int cpu)
+{
+	struct rcu_data *rdp = &per_cpu(rcu_sched_data, cpu);
+
+	if (unlikely(rdp->exp_qs_pending))
+		rcu_report_exp_sched_rdp(&rcu_sched_state, rdp);
+}
+
+/*
+ * IPI handler of the expedited RCU-sched grace periods.  An interrupt
+ * from user mode or idle is a quiescent state.  Otherwise the CPU may
+ * be in an RCU-sched read-side critical section, so ask it to report
+ * its next context switch and make that context switch happen soon.
+ */
+static void sync_sched_exp_handler(void *data)
+{
+	struct rcu_state *rsp = data;
+	struct rcu_data *rdp = this_cpu_ptr(rsp->rda);
+	struct rcu_node *rnp = rdp->mynode;
+
+	if (!(ACCESS_ONCE(rnp->expmask_sched) & rdp->grpmask))
+		return;
+	if (rcu_is_cpu_rrupt_from_idle()) {
+		rcu_report_exp_sched_rdp(rsp, rdp);
+		return;
+	}
+	rdp->exp_qs_pending = true;
+	set_need_resched();
+}
+
+/*
+ * Mark the ancestors of the leaf rcu_node structure @rnp as waiting on
+ * it for the current expedited grace period.
+ */
+static void sync_sched_exp_set_parents(struct rcu_node *rnp)
+{
+	bool done;
+	unsigned long flags;
+	unsigned long mask;
+
+	while (rnp->parent) {
+		mask = rnp->grpmask;
+		rnp = rnp->parent;
+		raw_spin_lock_irqsave(&rnp->lock, flags);
+		done = rnp->expmask_sched != 0;
+		rnp->expmask_sched |= mask;
+		raw_spin_unlock_irqrestore(&rnp->lock, flags);
+		if (done)
+			break;
+	}
+}
+
+/*
+ * Select the CPUs that an expedited RCU-sched grace period must wait
+ * on, then IPI them.  The CPUs in an extended quiescent state (dyntick
+ * idle or user mode), as well as the current one, are already in a
+ * quiescent state and are left alone.  The CPUs are scanned and the
+ * quiescent states are reported per leaf rcu_node structure, so that
+ * the root is only touched once per group.
+ */
+static void sync_sched_exp_select_cpus(struct rcu_state *rsp)
+{
+	int cpu;
+	int snap;
+	unsigned long flags;
+	unsigned long mask;
+	unsigned long mask_ipi;
+	struct rcu_data *rdp;
+	struct rcu_node *rnp;
+
+	rcu_for_each_leaf_node(rsp, rnp) {
+		mask_ipi = 0;
+		raw_spin_lock_irqsave(&rnp->lock, flags);
+		cpu = rnp->grplo;
+		mask = 1;
+		for (; cpu <= rnp->grphi; cpu++, mask <<= 1) {
+			if (!(rnp->qsmaskinit & mask) || !cpu_online(cpu))
+				continue;
+			if (cpu == smp_processor_id())
+				continue;
+			rdp = per_cpu_ptr(rsp->rda, cpu);
+			snap = atomic_add_return(0, &rdp->dynticks->dynticks);
+			if (!(snap & 0x1)) {
+				atomic_long_inc(&rsp->expedited_eqs);
+				continue;
+			}
+			mask_ipi |= mask;
+		}
+		rnp->expmask_sched = mask_ipi;
+		raw_spin_unlock_irqrestore(&rnp->lock, flags);
+		if (mask_ipi)
+			sync_sched_exp_set_parents(rnp);
+	}
+
+	rcu_for_each_leaf_node(rsp, rnp) {
+		mask_ipi = ACCESS_ONCE(rnp->expmask_sched);
+		cpu = rnp->grplo;
+		mask = 1;
+		for (; cpu <= rnp->grphi; cpu++, mask <<= 1) {
+			if (!(mask_ipi & mask))
+				continue;
+			smp_call_function_single(cpu, sync_sched_exp_handler,
+						 rsp, 0);
+			atomic_long_inc(&rsp->expedited_ipis);
+		}
+	}
 }
 
 /**
@@ -2423,42 +2795,37 @@ static int synchronize_sched_expedited_cpu_stop(void *data)
  *
  * Wait for an RCU-sched grace period to elapse, but use a "big hammer"
  * approach to force the grace period to end quickly.  This consumes
- * significant time on all CPUs and is unfriendly to real-time workloads,
- * so is thus not recommended for any sort of common-case code.  In fact,
- * if you are using synchronize_sched_expedited() in a loop, please
- * restructure your code to batch your updates, and then use a single
- * synchronize_sched() instead.
+ * significant time on the non-idle CPUs and is unfriendly to real-time
+ * workloads, so is thus not recommended for any sort of common-case
+ * code.  In fact, if you are using synchronize_sched_expedited() in a
+ * loop, please restructure your code to batch your updates, and then
+ * use a single synchronize_sched() instead.
  *
  * Note that it is illegal to call this function while holding any lock
  * that is acquired by a CPU-hotplug notifier.  And yes, it is also illegal
  * to call this function from a CPU-hotplug notifier.  Failing to observe
  * these restriction will result in deadlock.
  *
+ * The CPUs in an extended quiescent state, dyntick idle or user mode,
+ * are not disturbed.  The other ones get an IPI and, unless they were
+ * interrupted from idle or user mode, report a quiescent state on their
+ * next context switch.  See sync_sched_exp_select_cpus().
+ *
+ * The expedited grace periods are serialized by ->expedited_mutex.
  * This implementation can be thought of as an application of ticket
  * locking to RCU, with sync_sched_expedited_started and
  * sync_sched_expedited_done taking on the roles of the halves
  * of the ticket-lock word.  Each task atomically increments
- * sync_sched_expedited_started upon entry, snapshotting the old value,
- * then attempts to stop all the CPUs.  If this succeeds, then each
- * CPU will have executed a context switch, resulting in an RCU-sched
- * grace period.  We are then done, so we use atomic_cmpxchg() to
- * update sync_sched_expedited_done to match our snapshot -- but
- * only if someone else has not already advanced past our snapshot.
- *
- * On the other hand, if try_stop_cpus() fails, we check the value
- * of sync_sched_expedited_done.  If it has advanced past our
- * initial snapshot, then someone else must have forced a grace period
- * some time after we took our snapshot.  In this case, our work is
- * done for us, and we can simply return.  Otherwise, we try again,
- * but keep our initial snapshot for purposes of checking for someone
- * doing our work for us.
- *
- * If we fail too many times in a row, we fall back to synchronize_sched().
+ * sync_sched_expedited_started upon entry, snapshotting the old value.
+ * Once it holds the mutex, it checks sync_sched_expedited_done: if it
+ * advanced past the snapshot, then someone else forced a grace period
+ * some time after we took our snapshot and our work is done for us.
+ * Otherwise, the grace period we force covers all the tasks that took
+ * a ticket before we start it.
  */
 void synchronize_sched_expedited(void)
 {
 	long firstsnap, s, snap;
-	int trycount = 0;
 	struct rcu_state *rsp = &rcu_sched_state;
 
 	/*
@@ -2481,79 +2848,46 @@ void synchronize_sched_expedited(void)
 	 * Take a ticket.  Note that atomic_inc_return() implies a
 	 * full memory barrier.
 	 */
-	snap = atomic_long_inc_return(&rsp->expedited_start);
-	firstsnap = snap;
+	firstsnap = atomic_long_inc_return(&rsp->expedited_start);
 	get_online_cpus();
 	WARN_ON_ONCE(cpu_is_offline(raw_smp_processor_id()));
 
-	/*
-	 * Each pass through the following loop attempts to force a
-	 * context switch on each CPU.
-	 */
-	while (try_stop_cpus(cpu_online_mask,
-			     synchronize_sched_expedited_cpu_stop,
-			     NULL) == -EAGAIN) {
-		put_online_cpus();
+	if (!mutex_trylock(&rsp->expedited_mutex)) {
 		atomic_long_inc(&rsp->expedited_tryfail);
+		mutex_lock(&rsp->expedited_mutex);
+	}
 
-		/* Check to see if someone else did our work for us. */
-		s = atomic_long_read(&rsp->expedited_done);
-		if (ULONG_CMP_GE((ulong)s, (ulong)firstsnap)) {
-			/* ensure test happens before caller kfree */
-			smp_mb__before_atomic_inc(); /* ^^^ */
-			atomic_long_inc(&rsp->expedited_workdone1);
-			return;
-		}
-
-		/* No joy, try again later.  Or just synchronize_sched(). */
-		if (trycount++ < 10) {
-			udelay(trycount * num_online_cpus());
-		} else {
-			wait_rcu_gp(call_rcu_sched);
-			atomic_long_inc(&rsp->expedited_normal);
-			return;
-		}
+	/* Check to see if someone else did our work for us. */
+	s = atomic_long_read(&rsp->expedited_done);
+	if (ULONG_CMP_GE((ulong)s, (ulong)firstsnap)) {
+		mutex_unlock(&rsp->expedited_mutex);
+		put_online_cpus();
+		/* ensure test happens before caller kfree */
+		smp_mb__before_atomic_inc(); /* ^^^ */
+		atomic_long_inc(&rsp->expedited_workdone);
+		return;
+	}
 
-		/* Recheck to see if someone else did our work for us. */
-		s = atomic_long_read(&rsp->expedited_done);
-		if (ULONG_CMP_GE((ulong)s, (ulong)firstsnap)) {
-			/* ensure test happens before caller kfree */
-			smp_mb__before_atomic_inc(); /* ^^^ */
-			atomic_long_inc(&rsp->expedited_workdone2);
-			return;
-		}
+	/*
+	 * Refetching sync_sched_expedited_started allows later callers
+	 * to piggyback on our grace period: they started before it.
+	 */
+	snap = atomic_long_read(&rsp->expedited_start);
+	smp_mb(); /* ensure read is before the dynticks snapshots. */
 
-		/*
-		 * Refetching sync_sched_expedited_started allows later
-		 * callers to piggyback on our grace period.  We retry
-		 * after they started, so our grace period works for them,
-		 * and they started after our first try, so their grace
-		 * period works for us.
-		 */
-		get_online_cpus();
-		snap = atomic_long_read(&rsp->expedited_start);
-		smp_mb(); /* ensure read is before try_stop_cpus(). */
-	}
-	atomic_long_inc(&rsp->expedited_stoppedcpus);
+	sync_sched_exp_select_cpus(rsp);
+	wait_event(rsp->expedited_wq,
+		   !ACCESS_ONCE(rcu_get_root(rsp)->expmask_sched));
+	smp_mb(); /* ensure the quiescent states are before caller kfree. */
 
 	/*
 	 * Everyone up to our most recent fetch is covered by our grace
-	 * period.  Update the counter, but only if our work is still
-	 * relevant -- which it won't be if someone who started later
-	 * than we did already did their update.
+	 * period.  The mutex orders the updates of the done ticket.
 	 */
-	do {
-		atomic_long_inc(&rsp->expedited_done_tries);
-		s = atomic_long_read(&rsp->expedited_done);
-		if (ULONG_CMP_GE((ulong)s, (ulong)snap)) {
-			/* ensure test happens before caller kfree */
-			smp_mb__before_atomic_inc(); /* ^^^ */
-			atomic_long_inc(&rsp->expedited_done_lost);
-			break;
-		}
-	} while (atomic_long_cmpxchg(&rsp->expedited_done, s, snap) != s);
-	atomic_long_inc(&rsp->expedited_done_exit);
+	atomic_long_set(&rsp->expedited_done, snap);
+	atomic_long_inc(&rsp->expedited_gps);
 
+	mutex_unlock(&rsp->expedited_mutex);
 	put_online_cpus();
 }
 EXPORT_SYMBOL_GPL(synchronize_sched_expedited);
@@ -2741,6 +3075,9 @@ static void _rcu_barrier(struct rcu_state *rsp)
 	atomic_set(&rsp->barrier_cpu_count, 1);
 	get_online_cpus();
 
+	/* Queue the pending kfree_rcu() arrays ahead of our callbacks. */
+	kfree_rcu_submit_all();
+
 	/*
 	 * Force each CPU with callbacks to register a new callback.
 	 * When that callback is invoked, we will know that all of the
@@ -2855,6 +3192,8 @@ rcu_init_percpu_data(int cpu, struct rcu_state *rsp, int preemptible)
 	rdp->qlen_last_fqs_check = 0;
 	rdp->n_force_qs_snap = rsp->n_force_qs;
 	rdp->blimit = blimit;
+	rdp->cb_flood = false;
+	rdp->cb_offloaded = false;
 	init_callback_list(rdp);  /* Re-enable callbacks on this CPU. */
 	rdp->dynticks->dynticks_nesting = DYNTICK_TASK_EXIT_IDLE;
 	atomic_set(&rdp->dynticks->dynticks,
@@ -2945,6 +3284,7 @@ static int __cpuinit rcu_cpu_notify(struct notifier_block *self,
 	case CPU_UP_CANCELED_FROZEN:
 		for_each_rcu_flavor(rsp)
 			rcu_cleanup_dead_cpu(cpu, rsp);
+		kfree_rcu_cleanup_dead_cpu(cpu);
 		break;
 	default:
 		break;
@@ -2966,6 +3306,7 @@ static int __init rcu_spawn_gp_kthread(void)
 	for_each_rcu_flavor(rsp) {
 		t = kthread_run(rcu_gp_kthread, rsp, rsp->name);
 		BUG_ON(IS_ERR(t));
+		housekeeping_affine(t);
 		rnp = rcu_get_root(rsp);
 		raw_spin_lock_irqsave(&rnp->lock, flags);
 		rsp->gp_kthread = t;
@@ -3090,6 +3431,7 @@ static void __init rcu_init_one(struct rcu_state *rsp,
 
 	rsp->rda = rda;
 	init_waitqueue_head(&rsp->gp_wq);
+	init_waitqueue_head(&rsp->expedited_wq);
 	rnp = rsp->level[rcu_num_lvls - 1];
 	for_each_possible_cpu(i) {
 		while (i > rnp->grphi)
@@ -3171,6 +3513,7 @@ void __init rcu_init(void)
 	rcu_init_one(&rcu_bh_state, &rcu_bh_data);
 	__rcu_init_preempt();
 	rcu_init_nocb();
+	kfree_rcu_batch_init();
 	 open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
 
 	/*
@@ -134,6 +134,10 @@ struct rcu_node {
 				/*  elements that need to drain to allow the */
 				/*  current expedited grace period to */
 				/*  complete (only for TREE_PREEMPT_RCU). */
+	unsigned long expmask_sched;
+				/* CPUs or groups that need to pass through */
+				/*  a quiescent state for the current */
+				/*  expedited RCU-sched grace period. */
 	atomic_t wakemask;	/* CPUs whose kthread needs to be awakened. */
 				/*  Since this has meaning only for leaf */
 				/*  rcu_node structures, 32 bits suffices. */
@@ -244,6 +248,7 @@ struct rcu_data {
 	bool		qs_pending;	/* Core waits for quiesc state. */
 	bool		beenonline;	/* CPU online at least once. */
 	bool		preemptible;	/* Preemptible RCU? */
+	bool		exp_qs_pending;	/* Expedited GP waits for QS. */
 	struct rcu_node *mynode;	/* This CPU's leaf of hierarchy */
 	unsigned long grpmask;		/* Mask to apply to leaf qsmask. */
 #ifdef CONFIG_RCU_CPU_STALL_INFO
@@ -291,6 +296,15 @@ struct rcu_data {
 	unsigned long	n_force_qs_snap;
 					/* did other CPU force QS recently? */
 	long		blimit;		/* Upper limit on a processed batch */
+	bool		cb_flood;	/* Too many cbs, ignore ->blimit. */
+	bool		cb_offloaded;	/* Flood handed to the rcuc kthread. */
+	unsigned long	n_cbs_queued;	/* count of RCU cbs queued. */
+	unsigned long	n_cbs_queued_snap;
+					/* ->n_cbs_queued at last batch. */
+	unsigned long	cb_avg_ns;	/* Average cost of a callback (ns). */
+	unsigned long	n_cb_floods;	/* # of callback floods. */
+	unsigned long	n_batch_overruns; /* # of batches over the budget. */
+	long		qlen_max;	/* Highest ->qlen seen. */
 
 	/* 3) dynticks interface. */
 	struct rcu_dynticks *dynticks;	/* Shared per-CPU dynticks state. */
@@ -326,6 +340,23 @@ struct rcu_data {
 	int nocb_p_count_lazy;		/*  (approximate). */
 	wait_queue_head_t nocb_wq;	/* For nocb kthreads to sleep on. */
 	struct task_struct *nocb_kthread;
+	bool nocb_poll;			/* Group polls instead of sleeping. */
+
+	/* The following fields are used by the group leader. */
+	struct rcu_head *nocb_gp_head;	/* CBs waiting for GP. */
+	struct rcu_head **nocb_gp_tail;
+	long nocb_gp_count;		/* # CBs waiting for GP */
+	long nocb_gp_count_lazy;	/*  (approximate). */
+	bool nocb_leader_wake;		/* Is the nocb leader thread awake? */
+	struct rcu_data *nocb_next_follower;
+					/* Next follower in wakeup chain. */
+
+	/* The following fields are used by the followers. */
+	struct rcu_head *nocb_follower_head; /* CBs ready to invoke. */
+	struct rcu_head **nocb_follower_tail;
+	atomic_long_t nocb_follower_count; /* # CBs ready to invoke. */
+	atomic_long_t nocb_follower_count_lazy; /*  (approximate). */
+	struct rcu_data *nocb_leader;	/* Leader waits for GP for us. */
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
 	int cpu;
@@ -416,17 +447,16 @@ struct rcu_state {
 						/*  _rcu_barrier(). */
 	/* End of fields guarded by barrier_mutex. */
 
+	struct mutex expedited_mutex;		/* Serializes expedited GPs. */
+	wait_queue_head_t expedited_wq;		/* Wait for expedited GP end. */
 	atomic_long_t expedited_start;		/* Starting ticket. */
 	atomic_long_t expedited_done;		/* Done ticket. */
 	atomic_long_t expedited_wrap;		/* # near-wrap incidents. */
-	atomic_long_t expedited_tryfail;	/* # acquisition failures. */
-	atomic_long_t expedited_workdone1;	/* # done by others #1. */
-	atomic_long_t expedited_workdone2;	/* # done by others #2. */
-	atomic_long_t expedited_normal;		/* # fallbacks to normal. */
-	atomic_long_t expedited_stoppedcpus;	/* # successful stop_cpus. */
-	atomic_long_t expedited_done_tries;	/* # tries to update _done. */
-	atomic_long_t expedited_done_lost;	/* # times beaten to _done. */
-	atomic_long_t expedited_done_exit;	/* # times exited _done loop. */
+	atomic_long_t expedited_tryfail;	/* # mutex contentions. */
+	atomic_long_t expedited_workdone;	/* # done by others. */
+	atomic_long_t expedited_gps;		/* # expedited GPs forced. */
+	atomic_long_t expedited_eqs;		/* # CPUs skipped in EQS. */
+	atomic_long_t expedited_ipis;		/* # CPUs IPIed. */
 
 	unsigned long jiffies_force_qs;		/* Time at which to invoke */
 						/*  force_quiescent_state(). */
@@ -513,6 +543,7 @@ static void __init __rcu_init_preempt(void);
 static void rcu_initiate_boost(struct rcu_node *rnp, unsigned long flags);
 static void rcu_preempt_boost_start_gp(struct rcu_node *rnp);
 static void invoke_rcu_callbacks_kthread(void);
+static bool rcu_offload_callbacks_kthread(struct rcu_data *rdp);
 static bool rcu_is_callbacks_kthread(void);
 #ifdef CONFIG_RCU_BOOST
 static void rcu_preempt_do_callbacks(void);
@@ -547,8 +578,14 @@ static void __init rcu_init_nocb(void);
 /* Sum up queue lengths for tracing. */
 static inline void rcu_nocb_q_lengths(struct rcu_data *rdp, long *ql, long *qll)
 {
-	*ql = atomic_long_read(&rdp->nocb_q_count) + rdp->nocb_p_count;
-	*qll = atomic_long_read(&rdp->nocb_q_count_lazy) + rdp->nocb_p_count_lazy;
+	*ql = atomic_long_read(&rdp->nocb_q_count) +
+	      ACCESS_ONCE(rdp->nocb_gp_count) +
+	      atomic_long_read(&rdp->nocb_follower_count) +
+	      rdp->nocb_p_count;
+	*qll = atomic_long_read(&rdp->nocb_q_count_lazy) +
+	       ACCESS_ONCE(rdp->nocb_gp_count_lazy) +
+	       atomic_long_read(&rdp->nocb_follower_count_lazy) +
+	       rdp->nocb_p_count_lazy;
 }
 #else /* #ifdef CONFIG_RCU_NOCB_CPU */
 static inline void rcu_nocb_q_lengths(struct rcu_data *rdp, long *ql, long *qll)
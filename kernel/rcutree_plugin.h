@@ -28,6 +28,7 @@
 #include <linux/gfp.h>
 #include <linux/oom.h>
 #include <linux/smpboot.h>
+#include <linux/tick.h>
 
 #define RCU_KTHREAD_PRIO 1
 
@@ -41,6 +42,8 @@
 static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
 static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
 static bool __read_mostly rcu_nocb_poll;    /* Offload kthread are to poll. */
+static cpumask_var_t rcu_nocb_poll_mask; /* CPUs whose group is to poll. */
+static bool have_rcu_nocb_poll_mask;	 /* Was rcu_nocb_poll_mask allocated? */
 static char __initdata nocb_buf[NR_CPUS * 5];
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
@@ -84,6 +87,17 @@ static void __init rcu_bootup_announce_oddness(void)
 		printk(KERN_INFO "\tExperimental boot-time adjustment of leaf fanout to %d.\n", rcu_fanout_leaf);
 	if (nr_cpu_ids != NR_CPUS)
 		printk(KERN_INFO "\tRCU restricting CPUs from NR_CPUS=%d to nr_cpu_ids=%d.\n", NR_CPUS, nr_cpu_ids);
+#ifdef CONFIG_NO_HZ_FULL
+	/* Full dynticks CPUs must not invoke their own callbacks. */
+	if (tick_nohz_full_running) {
+		if (!have_rcu_nocb_mask &&
+		    zalloc_cpumask_var(&rcu_nocb_mask, GFP_KERNEL))
+			have_rcu_nocb_mask = true;
+		if (have_rcu_nocb_mask)
+			cpumask_or(rcu_nocb_mask, rcu_nocb_mask,
+				   tick_nohz_full_mask);
+	}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
 #ifdef CONFIG_RCU_NOCB_CPU
 	if (have_rcu_nocb_mask) {
 		if (cpumask_test_cpu(0, rcu_nocb_mask)) {
@@ -92,8 +106,14 @@ static void __init rcu_bootup_announce_oddness(void)
 		}
 		cpulist_scnprintf(nocb_buf, sizeof(nocb_buf), rcu_nocb_mask);
 		pr_info("\tExperimental no-CBs CPUs: %s.\n", nocb_buf);
-		if (rcu_nocb_poll)
+		if (rcu_nocb_poll) {
 			pr_info("\tExperimental polled no-CBs CPUs.\n");
+		} else if (have_rcu_nocb_poll_mask) {
+			cpulist_scnprintf(nocb_buf, sizeof(nocb_buf),
+					  rcu_nocb_poll_mask);
+			pr_info("\tExperimental polled no-CBs groups of CPUs: %s.\n",
+				nocb_buf);
+		}
 	}
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 }
@@ -672,11 +692,13 @@ EXPORT_SYMBOL_GPL(call_rcu);
  * but this change will require some way of tagging the lazy RCU
  * callbacks in the list of pending callbacks.  Until then, this
  * function may only be called from __kfree_rcu().
+ *
+ * The objects are freed in batches, see kfree_rcu_batch().
  */
 void kfree_call_rcu(struct rcu_head *head,
 		    void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_preempt_state, -1, 1);
+	kfree_rcu_batch(head, func, &rcu_preempt_state);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
@@ -1045,7 +1067,7 @@ static void rcu_preempt_check_callbacks(int cpu)
 void kfree_call_rcu(struct rcu_head *head,
 		    void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_sched_state, -1, 1);
+	kfree_rcu_batch(head, func, &rcu_sched_state);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
@@ -1301,6 +1323,20 @@ static bool rcu_is_callbacks_kthread(void)
 	return __get_cpu_var(rcu_cpu_kthread_task) == current;
 }
 
+/*
+ * Hand the callbacks that rcu_do_batch() could not invoke within the
+ * softirq time budget over to the per-CPU kthread, until it has worked
+ * them down.  Returns false if there is no kthread to hand them to.
+ */
+static bool rcu_offload_callbacks_kthread(struct rcu_data *rdp)
+{
+	if (__this_cpu_read(rcu_cpu_kthread_task) == NULL)
+		return false;
+	rdp->cb_offloaded = true;
+	invoke_rcu_callbacks_kthread();
+	return true;
+}
+
 #define RCU_BOOST_DELAY_JIFFIES DIV_ROUND_UP(CONFIG_RCU_BOOST_DELAY * HZ, 1000)
 
 /*
@@ -1498,6 +1534,11 @@ static bool rcu_is_callbacks_kthread(void)
 	return false;
 }
 
+static bool rcu_offload_callbacks_kthread(struct rcu_data *rdp)
+{
+	return false;
+}
+
 static void rcu_preempt_boost_start_gp(struct rcu_node *rnp)
 {
 }
@@ -2130,13 +2171,18 @@ static void increment_cpu_stall_ticks(void)
 /*
  * Offload callback processing from the boot-time-specified set of CPUs
  * specified by rcu_nocb_mask.  For each CPU in the set, there is a
- * kthread created that pulls the callbacks from the corresponding CPU,
- * waits for a grace period to elapse, and invokes the callbacks.
- * The no-CBs CPUs do a wake_up() on their kthread when they insert
- * a callback into any empty list, unless the rcu_nocb_poll boot parameter
- * has been specified, in which case each kthread actively polls its
- * CPU.  (Which isn't so great for energy efficiency, but which does
- * reduce RCU's overhead on that CPU.)
+ * kthread created that invokes the callbacks of the corresponding CPU.
+ * The kthreads are split into groups of about sqrt(nr_cpu_ids) CPUs,
+ * see rcu_nocb_leader_stride.  The kthread of the first CPU of each
+ * group is the leader: it pulls the callbacks from all the CPUs of its
+ * group, waits for a single grace period on their behalf, then wakes up
+ * only the followers that got callbacks to invoke.  The no-CBs CPUs do
+ * a wake_up() on their leader when they insert a callback into any empty
+ * list, unless their group polls, in which case the kthreads of the group
+ * actively poll their CPUs.  (Which isn't so great for energy efficiency,
+ * but which does reduce RCU's overhead on these CPUs.)  All the groups
+ * poll with the rcu_nocb_poll boot parameter, only the groups containing
+ * one of the listed CPUs with rcu_nocb_poll=<cpu list>.
  *
  * This is intended to be used in conjunction with Frederic Weisbecker's
  * adaptive-idle work, which would seriously reduce OS jitter on CPUs
@@ -2160,11 +2206,41 @@ __setup("rcu_nocbs=", rcu_nocb_setup);
 
 static int __init parse_rcu_nocb_poll(char *arg)
 {
-	rcu_nocb_poll = 1;
+	if (!arg || !*arg) {
+		rcu_nocb_poll = 1;
+		return 0;
+	}
+	alloc_bootmem_cpumask_var(&rcu_nocb_poll_mask);
+	have_rcu_nocb_poll_mask = true;
+	cpulist_parse(arg, rcu_nocb_poll_mask);
 	return 0;
 }
 early_param("rcu_nocb_poll", parse_rcu_nocb_poll);
 
+/*
+ * Number of CPUs per no-CBs kthread group, the default of -1 stands
+ * for sqrt(nr_cpu_ids).
+ */
+static int rcu_nocb_leader_stride = -1;
+module_param(rcu_nocb_leader_stride, int, 0444);
+
+/*
+ * Wake up the no-CBs leader kthread of the group of the specified CPU,
+ * unless it is already awake.
+ */
+static void wake_nocb_leader(struct rcu_data *rdp, bool force)
+{
+	struct rcu_data *rdp_leader = rdp->nocb_leader;
+
+	if (!ACCESS_ONCE(rdp_leader->nocb_kthread))
+		return;
+	if (!ACCESS_ONCE(rdp_leader->nocb_leader_wake) || force) {
+		/* Prior xchg orders against prior callback enqueue. */
+		ACCESS_ONCE(rdp_leader->nocb_leader_wake) = true;
+		wake_up(&rdp_leader->nocb_wq);
+	}
+}
+
 /* Is the specified CPU a no-CPUs CPU? */
 static bool is_nocb_cpu(int cpu)
 {
@@ -2196,16 +2272,18 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 	atomic_long_add(rhcount, &rdp->nocb_q_count);
 	atomic_long_add(rhcount_lazy, &rdp->nocb_q_count_lazy);
 
-	/* If we are not being polled and there is a kthread, awaken it ... */
+	/* If we are not being polled and there is a kthread, awaken ... */
 	t = ACCESS_ONCE(rdp->nocb_kthread);
-	if (rcu_nocb_poll | !t)
+	if (rdp->nocb_poll || !t)
 		return;
 	len = atomic_long_read(&rdp->nocb_q_count);
 	if (old_rhpp == &rdp->nocb_head) {
-		wake_up(&rdp->nocb_wq); /* ... only if queue was empty ... */
+		/* ... the leader only if queue was empty ... */
+		wake_nocb_leader(rdp, false);
 		rdp->qlen_last_fqs_check = 0;
 	} else if (len > rdp->qlen_last_fqs_check + qhimark) {
-		wake_up_process(t); /* ... or if many callbacks queued. */
+		/* ... or if many callbacks queued. */
+		wake_nocb_leader(rdp, true);
 		rdp->qlen_last_fqs_check = LONG_MAX / 2;
 	}
 	return;
@@ -2356,9 +2434,130 @@ static void call_rcu_sched_remote(struct rcu_head *rhp,
 	invoke_crf_remote(rhp, func, call_rcu_sched);
 }
 
+/*
+ * Leaders come here to wait for additional callbacks to show up.
+ * This function does not return until callbacks appear.
+ */
+static void nocb_leader_wait(struct rcu_data *my_rdp)
+{
+	bool gotcbs;
+	struct rcu_data *rdp;
+	struct rcu_head **tail;
+
+wait_again:
+
+	/* Wait for callbacks to appear. */
+	if (!my_rdp->nocb_poll) {
+		wait_event_interruptible(my_rdp->nocb_wq,
+				ACCESS_ONCE(my_rdp->nocb_leader_wake));
+		/* Memory barrier handled by smp_mb() calls below and repoll. */
+	}
+
+	/*
+	 * Each pass through the following loop checks a follower for CBs.
+	 * We are our own first follower.  Any CBs found are moved to
+	 * nocb_gp_head, where they await a grace period.
+	 */
+	gotcbs = false;
+	for (rdp = my_rdp; rdp; rdp = rdp->nocb_next_follower) {
+		rdp->nocb_gp_head = ACCESS_ONCE(rdp->nocb_head);
+		if (!rdp->nocb_gp_head)
+			continue;  /* No CBs here, try next follower. */
+
+		/* Move callbacks to wait-for-GP list, which is empty. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		rdp->nocb_gp_tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		ACCESS_ONCE(rdp->nocb_gp_count) =
+			atomic_long_xchg(&rdp->nocb_q_count, 0);
+		ACCESS_ONCE(rdp->nocb_gp_count_lazy) =
+			atomic_long_xchg(&rdp->nocb_q_count_lazy, 0);
+		gotcbs = true;
+	}
+
+	/*
+	 * If there were no callbacks, sleep a bit, rescan after a
+	 * memory barrier, and go retry.
+	 */
+	if (unlikely(!gotcbs)) {
+		flush_signals(current);
+		schedule_timeout_interruptible(1);
+
+		/* Rescan in case we were a victim of memory ordering. */
+		my_rdp->nocb_leader_wake = false;
+		smp_mb();  /* Ensure _wake false before scan. */
+		for (rdp = my_rdp; rdp; rdp = rdp->nocb_next_follower)
+			if (ACCESS_ONCE(rdp->nocb_head)) {
+				/* Found CB, so short-circuit next wait. */
+				my_rdp->nocb_leader_wake = true;
+				break;
+			}
+		goto wait_again;
+	}
+
+	/* Wait for one grace period for the whole group. */
+	wait_rcu_gp(my_rdp->rsp->call_remote);
+
+	/*
+	 * We left ->nocb_leader_wake set to reduce cache thrashing.
+	 * We clear it now, but recheck for new callbacks while
+	 * traversing our follower list.
+	 */
+	my_rdp->nocb_leader_wake = false;
+	smp_mb(); /* Ensure _wake false before scan of ->nocb_head. */
+
+	/* Each pass through the following loop wakes a follower, if needed. */
+	for (rdp = my_rdp; rdp; rdp = rdp->nocb_next_follower) {
+		if (ACCESS_ONCE(rdp->nocb_head))
+			my_rdp->nocb_leader_wake = true; /* No need to wait. */
+		if (!rdp->nocb_gp_head)
+			continue; /* No CBs, so no need to wake follower. */
+
+		/* Append callbacks to follower's "done" list. */
+		tail = xchg(&rdp->nocb_follower_tail, rdp->nocb_gp_tail);
+		*tail = rdp->nocb_gp_head;
+		atomic_long_add(rdp->nocb_gp_count, &rdp->nocb_follower_count);
+		atomic_long_add(rdp->nocb_gp_count_lazy,
+				&rdp->nocb_follower_count_lazy);
+		ACCESS_ONCE(rdp->nocb_gp_count) = 0;
+		ACCESS_ONCE(rdp->nocb_gp_count_lazy) = 0;
+		if (rdp != my_rdp && tail == &rdp->nocb_follower_head) {
+			/*
+			 * List was empty, wake up the follower.
+			 * Memory barriers supplied by atomic_long_add().
+			 */
+			wake_up(&rdp->nocb_wq);
+		}
+	}
+
+	/* If we (the leader) don't have CBs, go wait some more. */
+	if (!my_rdp->nocb_follower_head)
+		goto wait_again;
+}
+
+/*
+ * Followers come here to wait for additional callbacks to show up.
+ * This function does not return until callbacks appear.
+ */
+static void nocb_follower_wait(struct rcu_data *rdp)
+{
+	for (;;) {
+		if (!rdp->nocb_poll)
+			wait_event_interruptible(rdp->nocb_wq,
+					ACCESS_ONCE(rdp->nocb_follower_head));
+		if (ACCESS_ONCE(rdp->nocb_follower_head)) {
+			smp_rmb(); /* CB invocation follows _head test. */
+			return;
+		}
+		flush_signals(current);
+		schedule_timeout_interruptible(1);
+	}
+}
+
 /*
  * Per-rcu_data kthread, but only for no-CBs CPUs.  Each kthread invokes
- * callbacks queued by the corresponding no-CBs CPU.
+ * callbacks queued by the corresponding no-CBs CPU, however, there is
+ * an optional leader-follower relationship so that the grace-period
+ * kthreads don't have to do quite so many wakeups.
  */
 static int rcu_nocb_kthread(void *arg)
 {
@@ -2370,27 +2569,21 @@ static int rcu_nocb_kthread(void *arg)
 
 	/* Each pass through this loop invokes one batch of callbacks */
 	for (;;) {
-		/* If not polling, wait for next batch of callbacks. */
-		if (!rcu_nocb_poll)
-			wait_event_interruptible(rdp->nocb_wq, rdp->nocb_head);
-		list = ACCESS_ONCE(rdp->nocb_head);
-		if (!list) {
-			schedule_timeout_interruptible(1);
-			flush_signals(current);
-			continue;
-		}
-
-		/*
-		 * Extract queued callbacks, update counts, and wait
-		 * for a grace period to elapse.
-		 */
-		ACCESS_ONCE(rdp->nocb_head) = NULL;
-		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
-		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
-		cl = atomic_long_xchg(&rdp->nocb_q_count_lazy, 0);
+		/* Wait for callbacks. */
+		if (rdp->nocb_leader == rdp)
+			nocb_leader_wait(rdp);
+		else
+			nocb_follower_wait(rdp);
+
+		/* Pull the ready-to-invoke callbacks onto local list. */
+		list = ACCESS_ONCE(rdp->nocb_follower_head);
+		BUG_ON(!list);
+		ACCESS_ONCE(rdp->nocb_follower_head) = NULL;
+		tail = xchg(&rdp->nocb_follower_tail, &rdp->nocb_follower_head);
+		c = atomic_long_xchg(&rdp->nocb_follower_count, 0);
+		cl = atomic_long_xchg(&rdp->nocb_follower_count_lazy, 0);
 		ACCESS_ONCE(rdp->nocb_p_count) += c;
 		ACCESS_ONCE(rdp->nocb_p_count_lazy) += cl;
-		wait_rcu_gp(rdp->rsp->call_remote);
 
 		/* Each pass through the following loop invokes a callback. */
 		trace_rcu_batch_start(rdp->rsp->name, cl, c, -1);
@@ -2423,6 +2616,60 @@ static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
 {
 	rdp->nocb_tail = &rdp->nocb_head;
 	init_waitqueue_head(&rdp->nocb_wq);
+	rdp->nocb_follower_tail = &rdp->nocb_follower_head;
+}
+
+/*
+ * Initialize leader-follower relationships for all no-CBs CPU, and
+ * select the groups that poll.
+ */
+static void __init rcu_organize_nocb_kthreads(struct rcu_state *rsp)
+{
+	int cpu;
+	int ls = rcu_nocb_leader_stride;
+	int nl = 0;  /* Next leader. */
+	bool poll;
+	struct rcu_data *rdp;
+	struct rcu_data *rdp_leader = NULL;  /* Suppress misguided gcc warn. */
+	struct rcu_data *rdp_prev = NULL;
+
+	if (ls <= 0) {
+		ls = int_sqrt(nr_cpu_ids);
+		rcu_nocb_leader_stride = ls;
+	}
+
+	/*
+	 * Each pass through this loop sets up one rcu_data structure and
+	 * spawns one rcu_nocb_kthread().
+	 */
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (rdp->cpu >= nl) {
+			/* New leader, set up for followers & next leader. */
+			nl = DIV_ROUND_UP(rdp->cpu + 1, ls) * ls;
+			rdp->nocb_leader = rdp;
+			rdp_leader = rdp;
+		} else {
+			/* Another follower, link to previous leader. */
+			rdp->nocb_leader = rdp_leader;
+			rdp_prev->nocb_next_follower = rdp;
+		}
+		rdp_prev = rdp;
+	}
+
+	/* A group polls if any of its CPUs was asked to. */
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp_leader = per_cpu_ptr(rsp->rda, cpu);
+		if (rdp_leader->nocb_leader != rdp_leader)
+			continue;
+		poll = rcu_nocb_poll;
+		for (rdp = rdp_leader; rdp; rdp = rdp->nocb_next_follower)
+			if (have_rcu_nocb_poll_mask &&
+			    cpumask_test_cpu(rdp->cpu, rcu_nocb_poll_mask))
+				poll = true;
+		for (rdp = rdp_leader; rdp; rdp = rdp->nocb_next_follower)
+			rdp->nocb_poll = poll;
+	}
 }
 
 /* Create a kthread for each RCU flavor for each no-CBs CPU. */
@@ -2434,6 +2681,7 @@ static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
 
 	if (rcu_nocb_mask == NULL)
 		return;
+	rcu_organize_nocb_kthreads(rsp);
 	for_each_cpu(cpu, rcu_nocb_mask) {
 		rdp = per_cpu_ptr(rsp->rda, cpu);
 		t = kthread_run(rcu_nocb_kthread, rdp, "rcuo%d", cpu);
@@ -148,6 +148,10 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   per_cpu(rcu_cpu_kthread_loops, rdp->cpu) & 0xffff);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 	seq_printf(m, " b=%ld", rdp->blimit);
+	seq_printf(m, " fl=%c%c/%lu or=%lu cbns=%lu qlm=%ld",
+		   ".F"[rdp->cb_flood], ".K"[rdp->cb_offloaded],
+		   rdp->n_cb_floods, rdp->n_batch_overruns,
+		   rdp->cb_avg_ns, rdp->qlen_max);
 	seq_printf(m, " ci=%lu nci=%lu co=%lu ca=%lu\n",
 		   rdp->n_cbs_invoked, rdp->n_nocbs_invoked,
 		   rdp->n_cbs_orphaned, rdp->n_cbs_adopted);
@@ -183,18 +187,15 @@ static int show_rcuexp(struct seq_file *m, void *v)
 {
 	struct rcu_state *rsp = (struct rcu_state *)m->private;
 
-	seq_printf(m, "s=%lu d=%lu w=%lu tf=%lu wd1=%lu wd2=%lu n=%lu sc=%lu dt=%lu dl=%lu dx=%lu\n",
+	seq_printf(m, "s=%lu d=%lu w=%lu tf=%lu wd=%lu gp=%lu eqs=%lu ipi=%lu\n",
 		   atomic_long_read(&rsp->expedited_start),
 		   atomic_long_read(&rsp->expedited_done),
 		   atomic_long_read(&rsp->expedited_wrap),
 		   atomic_long_read(&rsp->expedited_tryfail),
-		   atomic_long_read(&rsp->expedited_workdone1),
-		   atomic_long_read(&rsp->expedited_workdone2),
-		   atomic_long_read(&rsp->expedited_normal),
-		   atomic_long_read(&rsp->expedited_stoppedcpus),
-		   atomic_long_read(&rsp->expedited_done_tries),
-		   atomic_long_read(&rsp->expedited_done_lost),
-		   atomic_long_read(&rsp->expedited_done_exit));
+		   atomic_long_read(&rsp->expedited_workdone),
+		   atomic_long_read(&rsp->expedited_gps),
+		   atomic_long_read(&rsp->expedited_eqs),
+		   atomic_long_read(&rsp->expedited_ipis));
 	return 0;
 }
 
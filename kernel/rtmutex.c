@@ -14,6 +14,7 @@
 #include <linux/export.h>
 #include <linux/sched.h>
 #include <linux/sched/rt.h>
+#include <linux/sched/deadline.h>
 #include <linux/timer.h>
 
 #include "rtmutex_common.h"
@@ -99,11 +100,23 @@ static inline void mark_rt_mutex_waiters(struct rt_mutex *lock)
  */
 int rt_mutex_getprio(struct task_struct *task)
 {
+	int prio;
+
 	if (likely(!task_has_pi_waiters(task)))
 		return task->normal_prio;
 
-	return min(task_top_pi_waiter(task)->pi_list_entry.prio,
+	prio = min(task_top_pi_waiter(task)->pi_list_entry.prio,
 		   task->normal_prio);
+
+	/*
+	 * Deadline tasks have no bandwidth reservation to lend, a
+	 * non deadline owner blocking one of them is boosted to the
+	 * highest RT priority instead.
+	 */
+	if (dl_prio(prio) && !dl_prio(task->normal_prio))
+		prio = 0;
+
+	return prio;
 }
 
 /*
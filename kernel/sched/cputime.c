@@ -4,6 +4,7 @@
 #include <linux/kernel_stat.h>
 #include <linux/static_key.h>
 #include <linux/context_tracking.h>
+#include <linux/moduleparam.h>
 #include "sched.h"
 
 
@@ -600,6 +601,18 @@ void thread_group_cputime_adjusted(struct task_struct *p, cputime_t *ut, cputime
 #endif /* !CONFIG_VIRT_CPU_ACCOUNTING */
 
 #ifdef CONFIG_VIRT_CPU_ACCOUNTING_GEN
+/*
+ * In lazy mode, the user/kernel transitions only sample the clock and
+ * add the elapsed time to the pending counters of the task, under the
+ * sequence count alone: all the writers run on the task's CPU with irqs
+ * disabled.  The pending time is folded into the regular accounting
+ * once it reaches a tick, on context switch, on irq and guest
+ * boundaries, and is added by the readers meanwhile.  The cpustat and
+ * cputimer updates are then as coarse as with the tick.
+ */
+static bool __read_mostly vtime_lazy;
+module_param(vtime_lazy, bool, 0644);
+
 static unsigned long long vtime_delta(struct task_struct *tsk)
 {
 	unsigned long long clock;
@@ -622,10 +635,80 @@ static cputime_t get_vtime_delta(struct task_struct *tsk)
 	return nsecs_to_cputime(delta);
 }
 
+/*
+ * Move the whole cputime units of @pending out of it, the remainder below
+ * cputime granularity stays pending so that no time is lost and readers
+ * adding the pending time never see cputime go backward.
+ */
+static cputime_t vtime_take_pending(unsigned long long *pending)
+{
+	cputime_t delta_cpu = nsecs_to_cputime(*pending);
+
+	*pending -= min_t(unsigned long long, *pending,
+			  cputime_to_nsecs(delta_cpu));
+
+	return delta_cpu;
+}
+
+/*
+ * Fold the lazy mode pending time into the regular accounting.
+ * Must be called with the vtime seqlock held.
+ */
+static void __vtime_fold_pending(struct task_struct *tsk)
+{
+	cputime_t delta_cpu;
+
+	if (tsk->vtime_utime_pending) {
+		delta_cpu = vtime_take_pending(&tsk->vtime_utime_pending);
+		if (delta_cpu)
+			account_user_time(tsk, delta_cpu,
+					  cputime_to_scaled(delta_cpu));
+	}
+	if (tsk->vtime_stime_pending) {
+		delta_cpu = vtime_take_pending(&tsk->vtime_stime_pending);
+		if (delta_cpu)
+			__account_system_time(tsk, delta_cpu,
+					      cputime_to_scaled(delta_cpu),
+					      CPUTIME_SYSTEM);
+	}
+}
+
+/*
+ * Lazy mode user/kernel transition: charge the time elapsed since the
+ * last snapshot to the pending counter of the context we leave.
+ */
+static void vtime_lazy_switch(struct task_struct *tsk, int whence)
+{
+	unsigned long long clock, delta = 0;
+
+	clock = local_clock();
+	if (clock > tsk->vtime_snap)
+		delta = clock - tsk->vtime_snap;
+
+	write_seqcount_begin(&tsk->vtime_seqlock.seqcount);
+	tsk->vtime_snap += delta;
+	if (tsk->vtime_snap_whence == VTIME_USER)
+		tsk->vtime_utime_pending += delta;
+	else
+		tsk->vtime_stime_pending += delta;
+	tsk->vtime_snap_whence = whence;
+	write_seqcount_end(&tsk->vtime_seqlock.seqcount);
+
+	/* the remainders kept on fold are each below a tick */
+	if (tsk->vtime_utime_pending >= TICK_NSEC ||
+	    tsk->vtime_stime_pending >= TICK_NSEC) {
+		write_seqlock(&tsk->vtime_seqlock);
+		__vtime_fold_pending(tsk);
+		write_sequnlock(&tsk->vtime_seqlock);
+	}
+}
+
 static void __vtime_account_system(struct task_struct *tsk)
 {
 	cputime_t delta_cpu = get_vtime_delta(tsk);
 
+	__vtime_fold_pending(tsk);
+
 	account_system_time(tsk, irq_count(), delta_cpu, cputime_to_scaled(delta_cpu));
 }
 
@@ -661,16 +744,34 @@ void vtime_account_user(struct task_struct *tsk)
 	delta_cpu = get_vtime_delta(tsk);
 
 	write_seqlock(&tsk->vtime_seqlock);
+	__vtime_fold_pending(tsk);
 	tsk->vtime_snap_whence = VTIME_SYS;
 	account_user_time(tsk, delta_cpu, cputime_to_scaled(delta_cpu));
 	write_sequnlock(&tsk->vtime_seqlock);
 }
 
+void vtime_user_exit(struct task_struct *tsk)
+{
+	if (!vtime_accounting_enabled())
+		return;
+
+	if (vtime_lazy) {
+		vtime_lazy_switch(tsk, VTIME_SYS);
+		return;
+	}
+	vtime_account_user(tsk);
+}
+
 void vtime_user_enter(struct task_struct *tsk)
 {
 	if (!vtime_accounting_enabled())
 		return;
 
+	if (vtime_lazy) {
+		vtime_lazy_switch(tsk, VTIME_USER);
+		return;
+	}
+
 	write_seqlock(&tsk->vtime_seqlock);
 	tsk->vtime_snap_whence = VTIME_USER;
 	__vtime_account_system(tsk);
@@ -713,7 +814,7 @@ void arch_vtime_task_switch(struct task_struct *prev)
 
 	write_seqlock(&current->vtime_seqlock);
 	current->vtime_snap_whence = VTIME_SYS;
-	current->vtime_snap = sched_clock();
+	current->vtime_snap = local_clock();
 	write_sequnlock(&current->vtime_seqlock);
 }
 
@@ -723,7 +824,7 @@ void vtime_init_idle(struct task_struct *t)
 
 	write_seqlock_irqsave(&t->vtime_seqlock, flags);
 	t->vtime_snap_whence = VTIME_SYS;
-	t->vtime_snap = sched_clock();
+	t->vtime_snap = local_clock();
 	write_sequnlock_irqrestore(&t->vtime_seqlock, flags);
 }
 
@@ -769,6 +870,10 @@ fetch_task_cputime(struct task_struct *t,
 		if (s_dst)
 			*s_dst = *s_src;
 
+		/* Lazy mode time that is not folded yet */
+		*udelta = t->vtime_utime_pending;
+		*sdelta = t->vtime_stime_pending;
+
 		/* Task is sleeping, nothing to add */
 		if (t->vtime_snap_whence == VTIME_SLEEPING ||
 		    is_idle_task(t))
@@ -781,10 +886,10 @@ fetch_task_cputime(struct task_struct *t,
 		 * the right place.
 		 */
 		if (t->vtime_snap_whence == VTIME_USER || t->flags & PF_VCPU) {
-			*udelta = delta;
+			*udelta += delta;
 		} else {
 			if (t->vtime_snap_whence == VTIME_SYS)
-				*sdelta = delta;
+				*sdelta += delta;
 		}
 	} while (read_seqretry(&t->vtime_seqlock, seq));
 }
@@ -95,6 +95,8 @@ static void print_cfs_group_stats(struct seq_file *m, int cpu, struct task_group
 	P(se->avg.runnable_avg_sum);
 	P(se->avg.runnable_avg_period);
 	P(se->avg.load_avg_contrib);
+	P(se->avg.running_avg_sum);
+	P(se->avg.utilization_avg_contrib);
 	P(se->avg.decay_count);
 #endif
 #undef PN
@@ -209,12 +211,16 @@ void print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq)
 			cfs_rq->nr_spread_over);
 	SEQ_printf(m, "  .%-30s: %d\n", "nr_running", cfs_rq->nr_running);
 	SEQ_printf(m, "  .%-30s: %ld\n", "load", cfs_rq->load.weight);
-#ifdef CONFIG_FAIR_GROUP_SCHED
 #ifdef CONFIG_SMP
 	SEQ_printf(m, "  .%-30s: %lld\n", "runnable_load_avg",
 			cfs_rq->runnable_load_avg);
 	SEQ_printf(m, "  .%-30s: %lld\n", "blocked_load_avg",
 			cfs_rq->blocked_load_avg);
+	SEQ_printf(m, "  .%-30s: %lu\n", "utilization_load_avg",
+			cfs_rq->utilization_load_avg);
+#endif
+#ifdef CONFIG_FAIR_GROUP_SCHED
+#ifdef CONFIG_SMP
 	SEQ_printf(m, "  .%-30s: %lld\n", "tg_load_avg",
 			(unsigned long long)atomic64_read(&cfs_rq->tg->load_avg));
 	SEQ_printf(m, "  .%-30s: %lld\n", "tg_load_contrib",
@@ -568,11 +574,27 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.load.weight);
 	P(policy);
 	P(prio);
+#ifdef CONFIG_NUMA_BALANCING
+	P(numa_preferred_nid);
+	P(total_numa_faults);
+#endif
 #undef PN
 #undef __PN
 #undef P
 #undef __P
 
+#ifdef CONFIG_NUMA_BALANCING
+	if (p->numa_faults) {
+		int nid;
+
+		for_each_online_node(nid) {
+			SEQ_printf(m, "numa_faults node=%d shared=%lu private=%lu\n",
+				   nid, p->numa_faults[task_faults_idx(nid, 0)],
+				   p->numa_faults[task_faults_idx(nid, 1)]);
+		}
+	}
+#endif
+
 	{
 		unsigned int this_cpu = raw_smp_processor_id();
 		u64 t0, t1;
@@ -714,6 +714,11 @@ static void update_curr(struct cfs_rq *cfs_rq)
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
 }
 
+static void update_curr_fair(struct rq *rq)
+{
+	update_curr(cfs_rq_of(&rq->curr->se));
+}
+
 static inline void
 update_stats_wait_start(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
@@ -791,9 +796,322 @@ unsigned int sysctl_numa_balancing_scan_size = 256;
 /* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
 unsigned int sysctl_numa_balancing_scan_delay = 1000;
 
+static unsigned long weighted_cpuload(const int cpu);
+static unsigned long power_of(int cpu);
+static unsigned long task_h_load(struct task_struct *p);
+
+/*
+ * The tasks of an mm that were seen sharing memory. Their faults are also
+ * accounted together, so that placement moves them to the same node
+ * instead of each following its own share of the faults.
+ */
+struct numa_group {
+	atomic_t refcount;
+
+	spinlock_t lock; /* nr_tasks, faults */
+	int nr_tasks;
+
+	struct rcu_head rcu;
+	unsigned long total_faults;
+	unsigned long faults[0];
+};
+
+static inline unsigned long task_faults(struct task_struct *p, int nid)
+{
+	if (!p->numa_faults)
+		return 0;
+
+	return p->numa_faults[task_faults_idx(nid, 0)] +
+		p->numa_faults[task_faults_idx(nid, 1)];
+}
+
+static inline unsigned long group_faults(struct task_struct *p, int nid)
+{
+	if (!p->numa_group)
+		return 0;
+
+	return p->numa_group->faults[task_faults_idx(nid, 0)] +
+		p->numa_group->faults[task_faults_idx(nid, 1)];
+}
+
+/*
+ * These return the fraction, in permille, of the faults of the task or of
+ * its group that were on @nid, comparable between tasks with a different
+ * fault rate.
+ */
+static inline unsigned long task_weight(struct task_struct *p, int nid)
+{
+	if (!p->numa_faults || !p->total_numa_faults)
+		return 0;
+
+	return 1000 * task_faults(p, nid) / p->total_numa_faults;
+}
+
+static inline unsigned long group_weight(struct task_struct *p, int nid)
+{
+	if (!p->numa_group || !p->numa_group->total_faults)
+		return 0;
+
+	return 1000 * group_faults(p, nid) / p->numa_group->total_faults;
+}
+
+/* The weight placement goes by: the group's when the task has one */
+static inline unsigned long numa_weight(struct task_struct *p, int nid)
+{
+	if (p->numa_group)
+		return group_weight(p, nid);
+
+	return task_weight(p, nid);
+}
+
+static void get_numa_group(struct numa_group *grp)
+{
+	atomic_inc(&grp->refcount);
+}
+
+static void put_numa_group(struct numa_group *grp)
+{
+	if (atomic_dec_and_test(&grp->refcount))
+		kfree_rcu(grp, rcu);
+}
+
+struct numa_stats {
+	unsigned long nr_running;
+	unsigned long load;
+
+	/* Total compute capacity of the cpus of a node */
+	unsigned long power;
+
+	/* Approximate capacity in terms of runnable tasks on a node */
+	unsigned long capacity;
+	int has_capacity;
+};
+
+static void update_numa_stats(struct numa_stats *ns, int nid)
+{
+	int cpu;
+
+	memset(ns, 0, sizeof(*ns));
+	for_each_cpu(cpu, cpumask_of_node(nid)) {
+		struct rq *rq = cpu_rq(cpu);
+
+		ns->nr_running += rq->nr_running;
+		ns->load += weighted_cpuload(cpu);
+		ns->power += power_of(cpu);
+	}
+
+	ns->capacity = DIV_ROUND_CLOSEST(ns->power, SCHED_POWER_SCALE);
+	ns->has_capacity = (ns->nr_running < ns->capacity);
+}
+
+struct task_numa_env {
+	struct task_struct *p;
+
+	int src_cpu, src_nid;
+	int dst_cpu, dst_nid;
+
+	struct numa_stats src_stats, dst_stats;
+
+	int imbalance_pct;
+
+	struct task_struct *best_task;
+	long best_imp;
+	int best_cpu;
+};
+
+static void task_numa_assign(struct task_numa_env *env,
+			     struct task_struct *p, long imp)
+{
+	if (env->best_task)
+		put_task_struct(env->best_task);
+	if (p)
+		get_task_struct(p);
+
+	env->best_task = p;
+	env->best_imp = imp;
+	env->best_cpu = env->dst_cpu;
+}
+
+/*
+ * Consider moving env->p to env->dst_cpu: either onto an idle cpu, or by
+ * swapping it with the task running there. @taskimp and @groupimp are the
+ * locality gains of the move for env->p alone and for its group, the swap
+ * adds what the other task gains by going to the source node.
+ */
+static void task_numa_compare(struct task_numa_env *env,
+			      long taskimp, long groupimp)
+{
+	struct rq *src_rq = cpu_rq(env->src_cpu);
+	struct rq *dst_rq = cpu_rq(env->dst_cpu);
+	struct task_struct *cur;
+	long src_load, dst_load;
+	long load;
+	long imp = env->p->numa_group ? groupimp : taskimp;
+
+	rcu_read_lock();
+	raw_spin_lock_irq(&dst_rq->lock);
+	cur = dst_rq->curr;
+	/*
+	 * No need to move the exiting task, and this ensures that ->curr
+	 * wasn't reaped and thus get_task_struct() in task_numa_assign()
+	 * is safe under RCU read lock.
+	 */
+	if ((cur->flags & PF_EXITING) || is_idle_task(cur))
+		cur = NULL;
+	raw_spin_unlock_irq(&dst_rq->lock);
+
+	if (cur == env->p)
+		goto unlock;
+
+	if (cur) {
+		/* Only swap with a fair task that may go to the source cpu */
+		if (cur->sched_class != &fair_sched_class ||
+		    !cpumask_test_cpu(env->src_cpu, tsk_cpus_allowed(cur)))
+			goto unlock;
+
+		/*
+		 * Swapping two tasks of the same group doesn't change the
+		 * locality of the group, only their own.
+		 */
+		if (cur->numa_group && cur->numa_group == env->p->numa_group)
+			imp = taskimp + task_weight(cur, env->src_nid) -
+			      task_weight(cur, env->dst_nid);
+		else
+			imp += numa_weight(cur, env->src_nid) -
+			       numa_weight(cur, env->dst_nid);
+	}
+
+	if (imp <= env->best_imp)
+		goto unlock;
+
+	if (!cur) {
+		/* Is there capacity at our destination? */
+		if (env->src_stats.has_capacity &&
+		    !env->dst_stats.has_capacity)
+			goto unlock;
+
+		goto balance;
+	}
+
+	/* Balance doesn't matter much if we're running a task per cpu */
+	if (src_rq->nr_running == 1 && dst_rq->nr_running == 1)
+		goto assign;
+
+balance:
+	/* In the overloaded case, try and keep the load balanced */
+	load = task_h_load(env->p);
+	dst_load = env->dst_stats.load + load;
+	src_load = env->src_stats.load - load;
+
+	if (cur) {
+		load = task_h_load(cur);
+		dst_load -= load;
+		src_load += load;
+	}
+
+	/* make src_load the smaller */
+	if (dst_load < src_load)
+		swap(dst_load, src_load);
+
+	if (src_load * env->imbalance_pct < dst_load * 100)
+		goto unlock;
+
+assign:
+	task_numa_assign(env, cur, imp);
+unlock:
+	rcu_read_unlock();
+}
+
+/*
+ * Move @p to the cpu of its preferred node that improves locality the most,
+ * swapping it with a task running there when the node has no spare
+ * capacity. Returns 0 when @p was moved.
+ */
+static int task_numa_migrate(struct task_struct *p)
+{
+	struct task_numa_env env = {
+		.p = p,
+
+		.src_cpu = task_cpu(p),
+		.src_nid = cpu_to_node(task_cpu(p)),
+
+		.imbalance_pct = 112,
+
+		.best_task = NULL,
+		.best_imp = 0,
+		.best_cpu = -1
+	};
+	struct sched_domain *sd;
+	long taskimp, groupimp;
+	int cpu, ret;
+
+	/*
+	 * Pick the lowest SD_NUMA domain, as that would have the smallest
+	 * imbalance and would be the first to start moving tasks about.
+	 */
+	rcu_read_lock();
+	for_each_domain(env.src_cpu, sd) {
+		if (sd->flags & SD_NUMA) {
+			env.imbalance_pct = 100 + (sd->imbalance_pct - 100) / 2;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	env.dst_nid = p->numa_preferred_nid;
+	if (cpumask_empty(cpumask_of_node(env.dst_nid)))
+		return -EINVAL;
+
+	update_numa_stats(&env.src_stats, env.src_nid);
+	update_numa_stats(&env.dst_stats, env.dst_nid);
+
+	taskimp = task_weight(p, env.dst_nid) - task_weight(p, env.src_nid);
+	groupimp = group_weight(p, env.dst_nid) - group_weight(p, env.src_nid);
+
+	for_each_cpu(cpu, cpumask_of_node(env.dst_nid)) {
+		/* Skip this cpu if the source task cannot migrate */
+		if (!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
+			continue;
+
+		env.dst_cpu = cpu;
+		task_numa_compare(&env, taskimp, groupimp);
+	}
+
+	/* No better cpu than the current one was found */
+	if (env.best_cpu == -1)
+		return -EAGAIN;
+
+	if (!env.best_task)
+		return migrate_task_to(p, env.best_cpu);
+
+	ret = migrate_swap(p, env.best_task);
+	put_task_struct(env.best_task);
+	return ret;
+}
+
+/* Attempt to migrate a task to a cpu on its preferred node */
+static void numa_migrate_preferred(struct task_struct *p)
+{
+	/* This task has no NUMA fault statistics yet */
+	if (unlikely(p->numa_preferred_nid == -1 || !p->numa_faults))
+		return;
+
+	/* Success if the task is already running on its preferred node */
+	if (cpu_to_node(task_cpu(p)) == p->numa_preferred_nid ||
+	    !task_numa_migrate(p)) {
+		p->numa_migrate_retry = 0;
+		return;
+	}
+
+	/* Periodically retry migrating the task to the preferred node */
+	p->numa_migrate_retry = jiffies + HZ;
+}
+
 static void task_numa_placement(struct task_struct *p)
 {
-	int seq;
+	struct numa_group *grp = p->numa_group;
+	unsigned long max_faults = 0;
+	int seq, nid, max_nid = -1;
 
 	if (!p->mm)	/* for example, ksmd faulting in a user's mm */
 		return;
@@ -802,30 +1120,206 @@ static void task_numa_placement(struct task_struct *p)
 		return;
 	p->numa_scan_seq = seq;
 
-	/* FIXME: Scheduling placement policy hints go here */
+	/* The other tasks of the group update its faults concurrently */
+	if (grp)
+		spin_lock_irq(&grp->lock);
+
+	/* Find the node with the highest number of faults */
+	for_each_online_node(nid) {
+		unsigned long faults = 0;
+		int priv, i;
+
+		for (priv = 0; priv < 2; priv++) {
+			long diff;
+
+			i = task_faults_idx(nid, priv);
+			diff = -p->numa_faults[i];
+
+			/* Decay existing window, copy faults since last scan */
+			p->numa_faults[i] >>= 1;
+			p->numa_faults[i] += p->numa_faults_buffer[i];
+			p->numa_faults_buffer[i] = 0;
+
+			diff += p->numa_faults[i];
+			p->total_numa_faults += diff;
+			faults += p->numa_faults[i];
+
+			if (grp) {
+				grp->faults[i] += diff;
+				grp->total_faults += diff;
+			}
+		}
+
+		/* Grouped tasks all go where the group faults the most */
+		if (grp)
+			faults = grp->faults[task_faults_idx(nid, 0)] +
+				 grp->faults[task_faults_idx(nid, 1)];
+
+		if (faults > max_faults) {
+			max_faults = faults;
+			max_nid = nid;
+		}
+	}
+
+	if (grp)
+		spin_unlock_irq(&grp->lock);
+
+	/* Update the preferred nid and migrate the task towards it */
+	if (max_faults && max_nid != p->numa_preferred_nid) {
+		p->numa_preferred_nid = max_nid;
+		numa_migrate_preferred(p);
+	}
+}
+
+/*
+ * This runs from __put_task_struct(), possibly in softirq context, hence
+ * the irq safe locking of grp->lock everywhere.
+ */
+static void numa_group_leave(struct task_struct *p)
+{
+	struct numa_group *grp = p->numa_group;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&grp->lock, flags);
+	for (i = 0; i < 2 * nr_node_ids; i++)
+		grp->faults[i] -= p->numa_faults[i];
+	grp->total_faults -= p->total_numa_faults;
+	grp->nr_tasks--;
+	spin_unlock_irqrestore(&grp->lock, flags);
+
+	rcu_assign_pointer(p->numa_group, NULL);
+	put_numa_group(grp);
 }
 
 /*
- * Got a PROT_NONE fault for a page on @node.
+ * A shared fault means that another task touched the page last. The
+ * page only records the low bits of its pid, so tasks are grouped by
+ * address space: threads sharing data with each other join the numa
+ * group of their mm.
  */
-void task_numa_fault(int node, int pages, bool migrated)
+static void task_numa_group(struct task_struct *p)
+{
+	struct mm_struct *mm = p->mm;
+	struct numa_group *grp, *old;
+	unsigned int size;
+	int i;
+
+	grp = ACCESS_ONCE(mm->numa_group);
+	if (grp && p->numa_group == grp)
+		return;
+
+	/* The task exec()ed into a new mm */
+	if (p->numa_group)
+		numa_group_leave(p);
+
+	if (!grp) {
+		size = sizeof(struct numa_group) +
+		       2 * nr_node_ids * sizeof(unsigned long);
+
+		grp = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+		if (!grp)
+			return;
+
+		/* The reference of the mm, dropped by mm_numa_free() */
+		atomic_set(&grp->refcount, 1);
+		spin_lock_init(&grp->lock);
+
+		old = cmpxchg(&mm->numa_group, NULL, grp);
+		if (old) {
+			kfree(grp);
+			grp = old;
+		}
+	}
+
+	get_numa_group(grp);
+
+	spin_lock_irq(&grp->lock);
+	for (i = 0; i < 2 * nr_node_ids; i++)
+		grp->faults[i] += p->numa_faults[i];
+	grp->total_faults += p->total_numa_faults;
+	grp->nr_tasks++;
+	spin_unlock_irq(&grp->lock);
+
+	rcu_assign_pointer(p->numa_group, grp);
+}
+
+void task_numa_free(struct task_struct *p)
+{
+	if (p->numa_group)
+		numa_group_leave(p);
+
+	kfree(p->numa_faults);
+	p->numa_faults = NULL;
+	p->numa_faults_buffer = NULL;
+}
+
+void mm_numa_free(struct mm_struct *mm)
+{
+	if (mm->numa_group) {
+		put_numa_group(mm->numa_group);
+		mm->numa_group = NULL;
+	}
+}
+
+/*
+ * Got a PROT_NONE fault for a page on @node, last touched as told by
+ * @last_nidpid.
+ */
+void task_numa_fault(int last_nidpid, int node, int pages, bool migrated)
 {
 	struct task_struct *p = current;
+	int this_pid = p->pid & LAST__PID_MASK;
+	int priv;
 
 	if (!sched_feat_numa(NUMA))
 		return;
 
-	/* FIXME: Allocate task-specific structure for placement policy here */
+	/* for example, ksmd faulting in a user's mm */
+	if (!p->mm)
+		return;
+
+	/* Allocate buffer to track faults on a per-node basis */
+	if (unlikely(!p->numa_faults)) {
+		int size = sizeof(*p->numa_faults) * 2 * nr_node_ids;
+
+		/* numa_faults and numa_faults_buffer share the allocation */
+		p->numa_faults = kzalloc(size * 2, GFP_KERNEL | __GFP_NOWARN);
+		if (!p->numa_faults)
+			return;
+
+		BUG_ON(p->numa_faults_buffer);
+		p->numa_faults_buffer = p->numa_faults + (2 * nr_node_ids);
+		p->total_numa_faults = 0;
+	}
+
+	/*
+	 * First accesses are treated as private, otherwise the fault is
+	 * private if the same task touched the page last.
+	 */
+	if (nidpid_pid_unset(last_nidpid))
+		priv = 1;
+	else
+		priv = (nidpid_to_pid(last_nidpid) == this_pid);
+
+	if (!priv)
+		task_numa_group(p);
 
 	/*
 	 * If pages are properly placed (did not migrate) then scan slower.
 	 * This is reset periodically in case of phase changes
 	 */
-        if (!migrated)
+	if (!migrated)
 		p->numa_scan_period = min(sysctl_numa_balancing_scan_period_max,
 			p->numa_scan_period + jiffies_to_msecs(10));
 
 	task_numa_placement(p);
+
+	/* Retry the migration to the preferred node if it failed before */
+	if (p->numa_migrate_retry && time_after(jiffies, p->numa_migrate_retry))
+		numa_migrate_preferred(p);
+
+	p->numa_faults_buffer[task_faults_idx(node, priv)] += pages;
 }
 
 static void reset_ptenuma_scan(struct task_struct *p)
@@ -1109,8 +1603,7 @@ static inline void update_cfs_shares(struct cfs_rq *cfs_rq)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
-/* Only depends on SMP, FAIR_GROUP_SCHED may be removed when useful in lb */
-#if defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)
+#ifdef CONFIG_SMP
 /*
  * We choose a half-life close to 1 scheduling period.
  * Note: The tables below are dependent on this value.
@@ -1227,10 +1720,15 @@ static u32 __compute_runnable_contrib(u64 n)
  * sum again by y is sufficient to update:
  *   load_avg = u_0` + y*(u_0 + u_1*y + u_2*y^2 + ... )
  *            = u_0 + u_1*y + u_2*y^2 + ... [re-labeling u_i --> u_{i+1}]
+ *
+ * The same series is kept for the fraction of each period the entity was
+ * actually running, which gives its utilization of the cpu: unlike the
+ * runnable average it doesn't grow with the time spent waiting for it.
  */
 static __always_inline int __update_entity_runnable_avg(u64 now,
 							struct sched_avg *sa,
-							int runnable)
+							int runnable,
+							int running)
 {
 	u64 delta, periods;
 	u32 runnable_contrib;
@@ -1269,6 +1767,8 @@ static __always_inline int __update_entity_runnable_avg(u64 now,
 		delta_w = 1024 - delta_w;
 		if (runnable)
 			sa->runnable_avg_sum += delta_w;
+		if (running)
+			sa->running_avg_sum += delta_w;
 		sa->runnable_avg_period += delta_w;
 
 		delta -= delta_w;
@@ -1279,6 +1779,8 @@ static __always_inline int __update_entity_runnable_avg(u64 now,
 
 		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
 						  periods + 1);
+		sa->running_avg_sum = decay_load(sa->running_avg_sum,
+						 periods + 1);
 		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
 						     periods + 1);
 
@@ -1286,12 +1788,16 @@ static __always_inline int __update_entity_runnable_avg(u64 now,
 		runnable_contrib = __compute_runnable_contrib(periods);
 		if (runnable)
 			sa->runnable_avg_sum += runnable_contrib;
+		if (running)
+			sa->running_avg_sum += runnable_contrib;
 		sa->runnable_avg_period += runnable_contrib;
 	}
 
 	/* Remainder of delta accrued against u_0` */
 	if (runnable)
 		sa->runnable_avg_sum += delta;
+	if (running)
+		sa->running_avg_sum += delta;
 	sa->runnable_avg_period += delta;
 
 	return decayed;
@@ -1409,6 +1915,22 @@ static inline void __update_task_entity_contrib(struct sched_entity *se)
 	se->avg.load_avg_contrib = scale_load(contrib);
 }
 
+/*
+ * Compute the current utilization of the cpu by se, return any delta. Group
+ * entities run whenever one of their children does, so this works the same
+ * at every level of the hierarchy.
+ */
+static long __update_entity_utilization_avg_contrib(struct sched_entity *se)
+{
+	long old_contrib = se->avg.utilization_avg_contrib;
+
+	se->avg.utilization_avg_contrib =
+		div_u64((u64)se->avg.running_avg_sum << SCHED_POWER_SHIFT,
+			se->avg.runnable_avg_period + 1);
+
+	return se->avg.utilization_avg_contrib - old_contrib;
+}
+
 /* Compute the current contribution to load_avg by se, return any delta */
 static long __update_entity_load_avg_contrib(struct sched_entity *se)
 {
@@ -1440,7 +1962,7 @@ static inline void update_entity_load_avg(struct sched_entity *se,
 					  int update_cfs_rq)
 {
 	struct cfs_rq *cfs_rq = cfs_rq_of(se);
-	long contrib_delta;
+	long contrib_delta, utilization_delta;
 	u64 now;
 
 	/*
@@ -1452,18 +1974,22 @@ static inline void update_entity_load_avg(struct sched_entity *se,
 	else
 		now = cfs_rq_clock_task(group_cfs_rq(se));
 
-	if (!__update_entity_runnable_avg(now, &se->avg, se->on_rq))
+	if (!__update_entity_runnable_avg(now, &se->avg, se->on_rq,
+					  cfs_rq->curr == se))
 		return;
 
 	contrib_delta = __update_entity_load_avg_contrib(se);
+	utilization_delta = __update_entity_utilization_avg_contrib(se);
 
 	if (!update_cfs_rq)
 		return;
 
-	if (se->on_rq)
+	if (se->on_rq) {
 		cfs_rq->runnable_load_avg += contrib_delta;
-	else
+		cfs_rq->utilization_load_avg += utilization_delta;
+	} else {
 		subtract_blocked_load_contrib(cfs_rq, -contrib_delta);
+	}
 }
 
 /*
@@ -1496,7 +2022,8 @@ static void update_cfs_rq_blocked_load(struct cfs_rq *cfs_rq, int force_update)
 
 static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
 {
-	__update_entity_runnable_avg(rq->clock_task, &rq->avg, runnable);
+	__update_entity_runnable_avg(rq->clock_task, &rq->avg, runnable,
+				     runnable);
 	__update_tg_runnable_avg(&rq->avg, &rq->cfs);
 }
 
@@ -1539,6 +2066,7 @@ static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
 	}
 
 	cfs_rq->runnable_load_avg += se->avg.load_avg_contrib;
+	cfs_rq->utilization_load_avg += se->avg.utilization_avg_contrib;
 	/* we force update consideration on load-balancer moves */
 	update_cfs_rq_blocked_load(cfs_rq, !wakeup);
 }
@@ -1557,6 +2085,7 @@ static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
 	update_cfs_rq_blocked_load(cfs_rq, !sleep);
 
 	cfs_rq->runnable_load_avg -= se->avg.load_avg_contrib;
+	cfs_rq->utilization_load_avg -= se->avg.utilization_avg_contrib;
 	if (sleep) {
 		cfs_rq->blocked_load_avg += se->avg.load_avg_contrib;
 		se->avg.decay_count = atomic64_read(&cfs_rq->decay_counter);
@@ -1864,6 +2393,8 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		 */
 		update_stats_wait_end(cfs_rq, se);
 		__dequeue_entity(cfs_rq, se);
+		/* The time since the last update was spent waiting */
+		update_entity_load_avg(se, 1);
 	}
 
 	update_stats_curr_start(cfs_rq, se);
@@ -2031,22 +2562,26 @@ static inline u64 sched_cfs_bandwidth_slice(void)
 }
 
 /*
- * Replenish runtime according to assigned quota and update expiration time.
- * We use sched_clock_cpu directly instead of rq->clock to avoid adding
- * additional synchronization around rq->lock.
+ * Replenish runtime according to assigned quota. Runtime left unused in the
+ * previous period is carried over, but the pool never exceeds quota + burst.
  *
  * requires cfs_b->lock
  */
 void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 {
-	u64 now;
+	s64 runtime, old, new;
 
 	if (cfs_b->quota == RUNTIME_INF)
 		return;
 
-	now = sched_clock_cpu(smp_processor_id());
-	cfs_b->runtime = cfs_b->quota;
-	cfs_b->runtime_expires = now + ktime_to_ns(cfs_b->period);
+	/* slack may be returned concurrently, see __return_cfs_rq_runtime() */
+	runtime = atomic64_read(&cfs_b->runtime);
+	do {
+		old = runtime;
+		new = min_t(s64, old + cfs_b->quota,
+			    cfs_b->quota + cfs_b->burst);
+		runtime = atomic64_cmpxchg(&cfs_b->runtime, old, new);
+	} while (runtime != old);
 }
 
 static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
@@ -2063,17 +2598,36 @@ static inline u64 cfs_rq_clock_task(struct cfs_rq *cfs_rq)
 	return rq_of(cfs_rq)->clock_task - cfs_rq->throttled_clock_task_time;
 }
 
+/*
+ * Take up to @amount from the global pool without cfs_b->lock, returns the
+ * runtime actually obtained.
+ */
+static u64 __grab_cfs_b_runtime(struct cfs_bandwidth *cfs_b, u64 amount)
+{
+	s64 runtime, old;
+
+	runtime = atomic64_read(&cfs_b->runtime);
+	do {
+		if (runtime <= 0)
+			return 0;
+		old = runtime;
+		runtime = atomic64_cmpxchg(&cfs_b->runtime, old,
+					   old - min_t(s64, old, amount));
+	} while (runtime != old);
+
+	return min_t(s64, old, amount);
+}
+
 /* returns 0 on failure to allocate runtime */
 static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 {
 	struct task_group *tg = cfs_rq->tg;
 	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
-	u64 amount = 0, min_amount, expires;
+	u64 amount, min_amount;
 
 	/* note: this is a positive sum as runtime_remaining <= 0 */
 	min_amount = sched_cfs_bandwidth_slice() - cfs_rq->runtime_remaining;
 
-	raw_spin_lock(&cfs_b->lock);
 	if (cfs_b->quota == RUNTIME_INF)
 		amount = min_amount;
 	else {
@@ -2083,72 +2637,47 @@ static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 		 * Refresh the global state and ensure bandwidth timer becomes
 		 * active.
 		 */
-		if (!cfs_b->timer_active) {
-			__refill_cfs_bandwidth_runtime(cfs_b);
-			__start_cfs_bandwidth(cfs_b);
+		if (unlikely(!ACCESS_ONCE(cfs_b->timer_active))) {
+			raw_spin_lock(&cfs_b->lock);
+			if (!cfs_b->timer_active) {
+				__refill_cfs_bandwidth_runtime(cfs_b);
+				__start_cfs_bandwidth(cfs_b);
+			}
+			raw_spin_unlock(&cfs_b->lock);
 		}
 
-		if (cfs_b->runtime > 0) {
-			amount = min(cfs_b->runtime, min_amount);
-			cfs_b->runtime -= amount;
-			cfs_b->idle = 0;
+		amount = __grab_cfs_b_runtime(cfs_b, min_amount);
+
+		/*
+		 * timer_active was read without the lock while the period
+		 * timer may be retiring an idle group. The first grab of a
+		 * period (idle still set) and a short one recheck it under the
+		 * lock: either the timer sees idle cleared and stays armed, or
+		 * we see it inactive and refill and rearm it ourselves.
+		 */
+		if (ACCESS_ONCE(cfs_b->idle) || amount < min_amount) {
+			raw_spin_lock(&cfs_b->lock);
+			if (!cfs_b->timer_active) {
+				__refill_cfs_bandwidth_runtime(cfs_b);
+				__start_cfs_bandwidth(cfs_b);
+				amount += __grab_cfs_b_runtime(cfs_b,
+						min_amount - amount);
+			}
+			if (amount)
+				cfs_b->idle = 0;
+			raw_spin_unlock(&cfs_b->lock);
 		}
 	}
-	expires = cfs_b->runtime_expires;
-	raw_spin_unlock(&cfs_b->lock);
 
 	cfs_rq->runtime_remaining += amount;
-	/*
-	 * we may have advanced our local expiration to account for allowed
-	 * spread between our sched_clock and the one on which runtime was
-	 * issued.
-	 */
-	if ((s64)(expires - cfs_rq->runtime_expires) > 0)
-		cfs_rq->runtime_expires = expires;
 
 	return cfs_rq->runtime_remaining > 0;
 }
 
-/*
- * Note: This depends on the synchronization provided by sched_clock and the
- * fact that rq->clock snapshots this value.
- */
-static void expire_cfs_rq_runtime(struct cfs_rq *cfs_rq)
-{
-	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
-	struct rq *rq = rq_of(cfs_rq);
-
-	/* if the deadline is ahead of our clock, nothing to do */
-	if (likely((s64)(rq->clock - cfs_rq->runtime_expires) < 0))
-		return;
-
-	if (cfs_rq->runtime_remaining < 0)
-		return;
-
-	/*
-	 * If the local deadline has passed we have to consider the
-	 * possibility that our sched_clock is 'fast' and the global deadline
-	 * has not truly expired.
-	 *
-	 * Fortunately we can check determine whether this the case by checking
-	 * whether the global deadline has advanced.
-	 */
-
-	if ((s64)(cfs_rq->runtime_expires - cfs_b->runtime_expires) >= 0) {
-		/* extend local deadline, drift is bounded above by 2 ticks */
-		cfs_rq->runtime_expires += TICK_NSEC;
-	} else {
-		/* global deadline is ahead, expiration has passed */
-		cfs_rq->runtime_remaining = 0;
-	}
-}
-
 static void __account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
 				     unsigned long delta_exec)
 {
-	/* dock delta_exec before expiring quota (as it could span periods) */
 	cfs_rq->runtime_remaining -= delta_exec;
-	expire_cfs_rq_runtime(cfs_rq);
 
 	if (likely(cfs_rq->runtime_remaining > 0))
 		return;
@@ -2313,8 +2842,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 		resched_task(rq->curr);
 }
 
-static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b,
-		u64 remaining, u64 expires)
+static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b, u64 remaining)
 {
 	struct cfs_rq *cfs_rq;
 	u64 runtime = remaining;
@@ -2334,7 +2862,6 @@ static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b,
 		remaining -= runtime;
 
 		cfs_rq->runtime_remaining += runtime;
-		cfs_rq->runtime_expires = expires;
 
 		/* we check whether we're throttled above */
 		if (cfs_rq->runtime_remaining > 0)
@@ -2359,7 +2886,7 @@ next:
  */
 static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 {
-	u64 runtime, runtime_expires;
+	u64 runtime;
 	int idle = 1, throttled;
 
 	raw_spin_lock(&cfs_b->lock);
@@ -2393,9 +2920,7 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	 * ensures that all existing debts will be paid before a new cfs_rq is
 	 * allowed to run.
 	 */
-	runtime = cfs_b->runtime;
-	runtime_expires = cfs_b->runtime_expires;
-	cfs_b->runtime = 0;
+	runtime = atomic64_xchg(&cfs_b->runtime, 0);
 
 	/*
 	 * This check is repeated as we are holding onto the new bandwidth
@@ -2405,15 +2930,14 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
 	while (throttled && runtime > 0) {
 		raw_spin_unlock(&cfs_b->lock);
 		/* we can't nest cfs_b->lock while distributing bandwidth */
-		runtime = distribute_cfs_runtime(cfs_b, runtime,
-						 runtime_expires);
+		runtime = distribute_cfs_runtime(cfs_b, runtime);
 		raw_spin_lock(&cfs_b->lock);
 
 		throttled = !list_empty(&cfs_b->throttled_cfs_rq);
 	}
 
-	/* return (any) remaining runtime */
-	cfs_b->runtime = runtime;
+	/* return (any) remaining runtime, slack may have arrived meanwhile */
+	atomic64_add(runtime, &cfs_b->runtime);
 	/*
 	 * While we are ensured activity in the period following an
 	 * unthrottle, this also covers the case in which the new bandwidth is
@@ -2466,28 +2990,33 @@ static void start_cfs_slack_bandwidth(struct cfs_bandwidth *cfs_b)
 				ns_to_ktime(cfs_bandwidth_slack_period));
 }
 
-/* we know any runtime found here is valid as update_curr() precedes return */
+/*
+ * Local runtime does not expire, so slack handed back by an idling cfs_rq is
+ * always valid and goes straight into the global pool instead of staying
+ * stranded on this cpu.
+ */
 static void __return_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 {
 	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
 	s64 slack_runtime = cfs_rq->runtime_remaining - min_cfs_rq_runtime;
+	s64 runtime;
 
 	if (slack_runtime <= 0)
 		return;
 
-	raw_spin_lock(&cfs_b->lock);
-	if (cfs_b->quota != RUNTIME_INF &&
-	    cfs_rq->runtime_expires == cfs_b->runtime_expires) {
-		cfs_b->runtime += slack_runtime;
+	if (cfs_b->quota == RUNTIME_INF)
+		goto out;
 
-		/* we are under rq->lock, defer unthrottling using a timer */
-		if (cfs_b->runtime > sched_cfs_bandwidth_slice() &&
-		    !list_empty(&cfs_b->throttled_cfs_rq))
-			start_cfs_slack_bandwidth(cfs_b);
-	}
-	raw_spin_unlock(&cfs_b->lock);
+	runtime = atomic64_add_return(slack_runtime, &cfs_b->runtime);
 
-	/* even if it's not valid for return we don't want to try again */
+	/* we are under rq->lock, defer unthrottling using a timer */
+	if (runtime > sched_cfs_bandwidth_slice() &&
+	    !list_empty(&cfs_b->throttled_cfs_rq)) {
+		raw_spin_lock(&cfs_b->lock);
+		start_cfs_slack_bandwidth(cfs_b);
+		raw_spin_unlock(&cfs_b->lock);
+	}
+out:
 	cfs_rq->runtime_remaining -= slack_runtime;
 }
 
@@ -2509,29 +3038,20 @@ static __always_inline void return_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 static void do_sched_cfs_slack_timer(struct cfs_bandwidth *cfs_b)
 {
 	u64 runtime = 0, slice = sched_cfs_bandwidth_slice();
-	u64 expires;
 
 	/* confirm we're still not at a refresh boundary */
 	if (runtime_refresh_within(cfs_b, min_bandwidth_expiration))
 		return;
 
-	raw_spin_lock(&cfs_b->lock);
-	if (cfs_b->quota != RUNTIME_INF && cfs_b->runtime > slice) {
-		runtime = cfs_b->runtime;
-		cfs_b->runtime = 0;
-	}
-	expires = cfs_b->runtime_expires;
-	raw_spin_unlock(&cfs_b->lock);
+	if (cfs_b->quota != RUNTIME_INF &&
+	    atomic64_read(&cfs_b->runtime) > slice)
+		runtime = atomic64_xchg(&cfs_b->runtime, 0);
 
 	if (!runtime)
 		return;
 
-	runtime = distribute_cfs_runtime(cfs_b, runtime, expires);
-
-	raw_spin_lock(&cfs_b->lock);
-	if (expires == cfs_b->runtime_expires)
-		cfs_b->runtime = runtime;
-	raw_spin_unlock(&cfs_b->lock);
+	runtime = distribute_cfs_runtime(cfs_b, runtime);
+	atomic64_add(runtime, &cfs_b->runtime);
 }
 
 /*
@@ -2614,8 +3134,9 @@ static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
 void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 {
 	raw_spin_lock_init(&cfs_b->lock);
-	cfs_b->runtime = 0;
+	atomic64_set(&cfs_b->runtime, 0);
 	cfs_b->quota = RUNTIME_INF;
+	cfs_b->burst = 0;
 	cfs_b->period = ns_to_ktime(default_cfs_period());
 
 	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
@@ -2894,10 +3415,31 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 }
 
 #ifdef CONFIG_SMP
-/* Used instead of source_load when we know the type == 0 */
+/*
+ * Used instead of source_load when we know the type == 0. This is the
+ * tracked load of the runnable entities, it doesn't jump with every
+ * enqueue and dequeue like the instantaneous rq->load.
+ */
 static unsigned long weighted_cpuload(const int cpu)
 {
-	return cpu_rq(cpu)->load.weight;
+	return cpu_rq(cpu)->cfs.runnable_load_avg;
+}
+
+/*
+ * The part of the cpu capacity used by the runnable fair tasks, in
+ * SCHED_POWER_SCALE units. Unlike the load, this doesn't depend on the
+ * weight of the tasks nor grow with the time they spend waiting.
+ */
+static unsigned long cpu_utilization(int cpu)
+{
+	unsigned long util = cpu_rq(cpu)->cfs.utilization_load_avg;
+
+	return min(util, SCHED_POWER_SCALE);
+}
+
+static inline unsigned long task_utilization(struct task_struct *p)
+{
+	return p->se.avg.utilization_avg_contrib;
 }
 
 /*
@@ -2944,7 +3486,7 @@ static unsigned long cpu_avg_load_per_task(int cpu)
 	unsigned long nr_running = ACCESS_ONCE(rq->nr_running);
 
 	if (nr_running)
-		return rq->load.weight / nr_running;
+		return rq->cfs.runnable_load_avg / nr_running;
 
 	return 0;
 }
@@ -3198,53 +3740,234 @@ find_idlest_group(struct sched_domain *sd, struct task_struct *p,
 		/* Tally up the load of all CPUs in the group */
 		avg_load = 0;
 
-		for_each_cpu(i, sched_group_cpus(group)) {
-			/* Bias balancing toward cpus of our domain */
-			if (local_group)
-				load = source_load(i, load_idx);
-			else
-				load = target_load(i, load_idx);
+		for_each_cpu(i, sched_group_cpus(group)) {
+			/* Bias balancing toward cpus of our domain */
+			if (local_group)
+				load = source_load(i, load_idx);
+			else
+				load = target_load(i, load_idx);
+
+			avg_load += load;
+		}
+
+		/* Adjust by relative CPU power of the group */
+		avg_load = (avg_load * SCHED_POWER_SCALE) / group->sgp->power;
+
+		if (local_group) {
+			this_load = avg_load;
+		} else if (avg_load < min_load) {
+			min_load = avg_load;
+			idlest = group;
+		}
+	} while (group = group->next, group != sd->groups);
+
+	if (!idlest || 100*this_load < imbalance*min_load)
+		return NULL;
+	return idlest;
+}
+
+/*
+ * find_idlest_cpu - find the idlest cpu among the cpus in group.
+ */
+static int
+find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
+{
+	unsigned long load, min_load = ULONG_MAX;
+	int idlest = -1;
+	int i;
+
+	/* Traverse only the allowed CPUs */
+	for_each_cpu_and(i, sched_group_cpus(group), tsk_cpus_allowed(p)) {
+		load = weighted_cpuload(i);
+
+		if (load < min_load || (load == min_load && i == this_cpu)) {
+			min_load = load;
+			idlest = i;
+		}
+	}
+
+	return idlest;
+}
+
+#ifdef CONFIG_SCHED_SMT
+static inline void set_idle_cores(struct sched_domain_shared *sds, int core)
+{
+	int cpu;
+
+	for_each_cpu(cpu, cpu_smt_mask(core))
+		cpumask_set_cpu(cpu, sds_idle_cores(sds));
+}
+
+static inline void clear_idle_cores(struct sched_domain_shared *sds, int core)
+{
+	int cpu;
+
+	for_each_cpu(cpu, cpu_smt_mask(core))
+		cpumask_clear_cpu(cpu, sds_idle_cores(sds));
+}
+
+/*
+ * Scans the local SMT mask to see if the entire core is idle, and records
+ * this information in the idle cores of the LLC.
+ *
+ * Called from the idle class on idle entry, with rq->lock held. rq->curr
+ * is not yet the idle task so the local cpu is assumed idle.
+ */
+void update_idle_core(struct rq *rq)
+{
+	int core = cpu_of(rq);
+	struct sched_domain_shared *sds;
+	int cpu;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, core));
+	if (!sds || cpumask_test_cpu(core, sds_idle_cores(sds)))
+		goto unlock;
+
+	for_each_cpu(cpu, cpu_smt_mask(core)) {
+		if (cpu == core)
+			continue;
+
+		if (!idle_cpu(cpu))
+			goto unlock;
+	}
+
+	set_idle_cores(sds, core);
+unlock:
+	rcu_read_unlock();
+}
+
+/*
+ * Called from the idle class on idle exit, with rq->lock held: the core
+ * of this cpu isn't idle anymore.
+ */
+void clear_idle_core(struct rq *rq)
+{
+	int core = cpu_of(rq);
+	struct sched_domain_shared *sds;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, core));
+	/* Only write the shared cacheline if the state changes */
+	if (sds && cpumask_test_cpu(core, sds_idle_cores(sds)))
+		clear_idle_cores(sds, core);
+	rcu_read_unlock();
+}
+
+/*
+ * Find an entirely idle core in the LLC of @target. The idle cores are
+ * read from the bitmap of the LLC instead of scanning its cpus, the cost
+ * only depends on the number of idle cores we have to check. Cores found
+ * busy are stale hints and get cleared.
+ */
+static int select_idle_core(struct task_struct *p, int target)
+{
+	struct sched_domain_shared *sds;
+	int core, cpu;
+
+	sds = rcu_dereference(per_cpu(sd_llc_shared, target));
+	if (!sds)
+		return -1;
+
+	for_each_cpu_and(core, sds_idle_cores(sds), tsk_cpus_allowed(p)) {
+		bool idle = true;
+
+		for_each_cpu(cpu, cpu_smt_mask(core)) {
+			if (!idle_cpu(cpu)) {
+				idle = false;
+				break;
+			}
+		}
+
+		if (idle)
+			return core;
+
+		clear_idle_cores(sds, core);
+	}
+
+	return -1;
+}
+
+/*
+ * Scan the local SMT mask for idle CPUs.
+ */
+static int select_idle_smt(struct task_struct *p, int target)
+{
+	int cpu;
 
-			avg_load += load;
-		}
+	for_each_cpu_and(cpu, cpu_smt_mask(target), tsk_cpus_allowed(p)) {
+		if (idle_cpu(cpu))
+			return cpu;
+	}
 
-		/* Adjust by relative CPU power of the group */
-		avg_load = (avg_load * SCHED_POWER_SCALE) / group->sgp->power;
+	return -1;
+}
 
-		if (local_group) {
-			this_load = avg_load;
-		} else if (avg_load < min_load) {
-			min_load = avg_load;
-			idlest = group;
-		}
-	} while (group = group->next, group != sd->groups);
+#else /* CONFIG_SCHED_SMT */
 
-	if (!idlest || 100*this_load < imbalance*min_load)
-		return NULL;
-	return idlest;
+static inline int select_idle_core(struct task_struct *p, int target)
+{
+	return -1;
+}
+
+static inline int select_idle_smt(struct task_struct *p, int target)
+{
+	return -1;
 }
 
+#endif /* CONFIG_SCHED_SMT */
+
 /*
- * find_idlest_cpu - find the idlest cpu among the cpus in group.
+ * Scan the LLC domain for idle CPUs, starting right after @target. With
+ * SIS_PROP the number of cpus scanned is proportional to the average idle
+ * time of this cpu over the average cost of a scan, so that a wakeup on a
+ * busy system doesn't pay for a full walk of a big LLC.
  */
-static int
-find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
+static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd,
+			   int target)
 {
-	unsigned long load, min_load = ULONG_MAX;
-	int idlest = -1;
-	int i;
+	int cpu, nr = sd->span_weight;
+	u64 time, cost;
+	s64 delta;
 
-	/* Traverse only the allowed CPUs */
-	for_each_cpu_and(i, sched_group_cpus(group), tsk_cpus_allowed(p)) {
-		load = weighted_cpuload(i);
+	if (sched_feat(SIS_PROP)) {
+		/*
+		 * Due to large variance we need a large fuzz factor,
+		 * hackbench in particular is sensitive here.
+		 */
+		u64 avg_idle = this_rq()->avg_idle / 512;
+		u64 avg_cost = sd->avg_scan_cost + 1;
+		u64 span_avg = sd->span_weight * avg_idle;
 
-		if (load < min_load || (load == min_load && i == this_cpu)) {
-			min_load = load;
-			idlest = i;
+		if (span_avg > 4 * avg_cost)
+			nr = div64_u64(span_avg, avg_cost);
+		else
+			nr = 4;
+	}
+
+	time = local_clock();
+
+	cpu = target;
+	for (;;) {
+		cpu = cpumask_next_and(cpu, sched_domain_span(sd),
+				       tsk_cpus_allowed(p));
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first_and(sched_domain_span(sd),
+						tsk_cpus_allowed(p));
+		if (cpu >= nr_cpu_ids || cpu == target || !nr--) {
+			cpu = -1;
+			break;
 		}
+		if (idle_cpu(cpu))
+			break;
 	}
 
-	return idlest;
+	time = local_clock() - time;
+	cost = sd->avg_scan_cost;
+	delta = (s64)(time - cost) / 8;
+	sd->avg_scan_cost += delta;
+
+	return cpu;
 }
 
 /*
@@ -3253,7 +3976,6 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 static int select_idle_sibling(struct task_struct *p, int target)
 {
 	struct sched_domain *sd;
-	struct sched_group *sg;
 	int i = task_cpu(p);
 
 	if (idle_cpu(target))
@@ -3265,30 +3987,27 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	if (i != target && cpus_share_cache(i, target) && idle_cpu(i))
 		return i;
 
+	sd = rcu_dereference(per_cpu(sd_llc, target));
+	if (!sd)
+		return target;
+
 	/*
-	 * Otherwise, iterate the domains and find an elegible idle cpu.
+	 * Otherwise prefer an idle core, so that the task doesn't share
+	 * a core with a busy sibling, then any idle cpu of the LLC, and
+	 * finally an idle sibling of the target.
 	 */
-	sd = rcu_dereference(per_cpu(sd_llc, target));
-	for_each_lower_domain(sd) {
-		sg = sd->groups;
-		do {
-			if (!cpumask_intersects(sched_group_cpus(sg),
-						tsk_cpus_allowed(p)))
-				goto next;
+	i = select_idle_core(p, target);
+	if (i >= 0)
+		return i;
 
-			for_each_cpu(i, sched_group_cpus(sg)) {
-				if (i == target || !idle_cpu(i))
-					goto next;
-			}
+	i = select_idle_cpu(p, sd, target);
+	if (i >= 0)
+		return i;
+
+	i = select_idle_smt(p, target);
+	if (i >= 0)
+		return i;
 
-			target = cpumask_first_and(sched_group_cpus(sg),
-					tsk_cpus_allowed(p));
-			goto done;
-next:
-			sg = sg->next;
-		} while (sg != sd->groups);
-	}
-done:
 	return target;
 }
 
@@ -3393,12 +4112,6 @@ unlock:
 	return new_cpu;
 }
 
-/*
- * Load-tracking only depends on SMP, FAIR_GROUP_SCHED dependency below may be
- * removed when useful for applications beyond shares distribution (e.g.
- * load-balance).
- */
-#ifdef CONFIG_FAIR_GROUP_SCHED
 /*
  * Called immediately before a task is migrated to a new cpu; task_cpu(p) and
  * cfs_rq_of(p) references at time of call are still valid and identify the
@@ -3422,7 +4135,6 @@ migrate_task_rq_fair(struct task_struct *p, int next_cpu)
 		atomic64_add(se->avg.load_avg_contrib, &cfs_rq->removed_load);
 	}
 }
-#endif
 #endif /* CONFIG_SMP */
 
 static unsigned long
@@ -3798,6 +4510,16 @@ static unsigned long __read_mostly max_load_balance_interval = HZ/10;
 #define LBF_NEED_BREAK	0x02
 #define LBF_SOME_PINNED 0x04
 
+/*
+ * What a load balance pass moves to fix the imbalance, env->imbalance is
+ * expressed in the same unit.
+ */
+enum migration_type {
+	migrate_load = 0,
+	migrate_util,
+	migrate_task,
+};
+
 struct lb_env {
 	struct sched_domain	*sd;
 
@@ -3811,6 +4533,7 @@ struct lb_env {
 	int			new_dst_cpu;
 	enum cpu_idle_type	idle;
 	long			imbalance;
+	enum migration_type	migration_type;
 	/* The set of CPUs under consideration for load-balancing */
 	struct cpumask		*cpus;
 
@@ -3865,6 +4588,63 @@ task_hot(struct task_struct *p, u64 now, struct sched_domain *sd)
 	return delta < (s64)sysctl_sched_migration_cost;
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/* Returns true if the destination node has incurred more faults */
+static bool migrate_improves_locality(struct task_struct *p, struct lb_env *env)
+{
+	int src_nid, dst_nid;
+
+	if (!sched_feat(NUMA_FAVOUR_HIGHER) || !p->numa_faults ||
+	    !(env->sd->flags & SD_NUMA))
+		return false;
+
+	src_nid = cpu_to_node(env->src_cpu);
+	dst_nid = cpu_to_node(env->dst_cpu);
+
+	if (src_nid == dst_nid)
+		return false;
+
+	/* Always encourage migration to the preferred node */
+	if (dst_nid == p->numa_preferred_nid)
+		return true;
+
+	return numa_weight(p, dst_nid) > numa_weight(p, src_nid);
+}
+
+static bool migrate_degrades_locality(struct task_struct *p, struct lb_env *env)
+{
+	int src_nid, dst_nid;
+
+	if (!sched_feat(NUMA_RESIST_LOWER) || !p->numa_faults ||
+	    !(env->sd->flags & SD_NUMA))
+		return false;
+
+	src_nid = cpu_to_node(env->src_cpu);
+	dst_nid = cpu_to_node(env->dst_cpu);
+
+	if (src_nid == dst_nid)
+		return false;
+
+	/* Migrating away from the preferred node is always bad */
+	if (src_nid == p->numa_preferred_nid)
+		return true;
+
+	return numa_weight(p, dst_nid) < numa_weight(p, src_nid);
+}
+#else
+static inline bool migrate_improves_locality(struct task_struct *p,
+					     struct lb_env *env)
+{
+	return false;
+}
+
+static inline bool migrate_degrades_locality(struct task_struct *p,
+					     struct lb_env *env)
+{
+	return false;
+}
+#endif
+
 /*
  * can_migrate_task - may task p from runqueue rq be migrated to this_cpu?
  */
@@ -3913,11 +4693,25 @@ int can_migrate_task(struct task_struct *p, struct lb_env *env)
 
 	/*
 	 * Aggressive migration if:
-	 * 1) task is cache cold, or
-	 * 2) too many balance attempts have failed.
+	 * 1) destination numa is preferred
+	 * 2) task is cache cold, or
+	 * 3) too many balance attempts have failed.
 	 */
 
 	tsk_cache_hot = task_hot(p, env->src_rq->clock_task, env->sd);
+	if (!tsk_cache_hot)
+		tsk_cache_hot = migrate_degrades_locality(p, env);
+
+	if (migrate_improves_locality(p, env)) {
+#ifdef CONFIG_SCHEDSTATS
+		if (tsk_cache_hot) {
+			schedstat_inc(env->sd, lb_hot_gained[env->idle]);
+			schedstat_inc(p, se.statistics.nr_forced_migrations);
+		}
+#endif
+		return 1;
+	}
+
 	if (!tsk_cache_hot ||
 		env->sd->nr_balance_failed > env->sd->cache_nice_tries) {
 #ifdef CONFIG_SCHEDSTATS
@@ -3971,8 +4765,9 @@ static unsigned long task_h_load(struct task_struct *p);
 static const unsigned int sched_nr_migrate_break = 32;
 
 /*
- * move_tasks tries to move up to imbalance weighted load from busiest to
- * this_rq, as part of a balancing operation within domain "sd".
+ * move_tasks tries to move up to imbalance weighted load, utilization or
+ * number of tasks, as told by env->migration_type, from busiest to this_rq,
+ * as part of a balancing operation within domain "sd".
  * Returns 1 if successful and 0 otherwise.
  *
  * Called with both runqueues locked.
@@ -4005,13 +4800,30 @@ static int move_tasks(struct lb_env *env)
 		if (throttled_lb_pair(task_group(p), env->src_cpu, env->dst_cpu))
 			goto next;
 
-		load = task_h_load(p);
+		switch (env->migration_type) {
+		case migrate_load:
+			load = task_h_load(p);
 
-		if (sched_feat(LB_MIN) && load < 16 && !env->sd->nr_balance_failed)
-			goto next;
+			if (sched_feat(LB_MIN) && load < 16 &&
+			    !env->sd->nr_balance_failed)
+				goto next;
 
-		if ((load / 2) > env->imbalance)
-			goto next;
+			if ((load / 2) > env->imbalance)
+				goto next;
+			break;
+
+		case migrate_util:
+			load = task_utilization(p);
+
+			/* Don't overshoot the spare capacity of dst */
+			if (load > env->imbalance)
+				goto next;
+			break;
+
+		case migrate_task:
+			load = 1;
+			break;
+		}
 
 		if (!can_migrate_task(p, env))
 			goto next;
@@ -4032,7 +4844,7 @@ static int move_tasks(struct lb_env *env)
 
 		/*
 		 * We only want to steal up to the prescribed amount of
-		 * weighted load.
+		 * load, utilization or tasks.
 		 */
 		if (env->imbalance <= 0)
 			break;
@@ -4121,11 +4933,13 @@ static int tg_load_down(struct task_group *tg, void *data)
 	long cpu = (long)data;
 
 	if (!tg->parent) {
-		load = cpu_rq(cpu)->load.weight;
+		load = cpu_rq(cpu)->cfs.runnable_load_avg;
 	} else {
-		load = tg->parent->cfs_rq[cpu]->h_load;
-		load *= tg->se[cpu]->load.weight;
-		load /= tg->parent->cfs_rq[cpu]->load.weight + 1;
+		struct cfs_rq *parent = tg->parent->cfs_rq[cpu];
+
+		load = div64_u64((u64)parent->h_load *
+				 tg->se[cpu]->avg.load_avg_contrib,
+				 parent->runnable_load_avg + 1);
 	}
 
 	tg->cfs_rq[cpu]->h_load = load;
@@ -4151,16 +4965,21 @@ static void update_h_load(long cpu)
 static unsigned long task_h_load(struct task_struct *p)
 {
 	struct cfs_rq *cfs_rq = task_cfs_rq(p);
-	unsigned long load;
-
-	load = p->se.load.weight;
-	load = div_u64(load * cfs_rq->h_load, cfs_rq->load.weight + 1);
 
-	return load;
+	return div64_u64((u64)p->se.avg.load_avg_contrib * cfs_rq->h_load,
+			 cfs_rq->runnable_load_avg + 1);
 }
 #else
 static inline void update_blocked_averages(int cpu)
 {
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_cfs_rq_blocked_load(&rq->cfs, 1);
+	update_rq_runnable_avg(rq, rq->nr_running);
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
 }
 
 static inline void update_h_load(long cpu)
@@ -4169,11 +4988,30 @@ static inline void update_h_load(long cpu)
 
 static unsigned long task_h_load(struct task_struct *p)
 {
-	return p->se.load.weight;
+	return p->se.avg.load_avg_contrib;
 }
 #endif
 
 /********** Helpers for find_busiest_group ************************/
+
+/*
+ * group_type - what a sched_group needs from the load balancer. Ordered
+ * by pulling priority, so the busiest group is the one with the highest
+ * type:
+ *
+ * group_has_spare:  the group can take more work, only the number of
+ *                   tasks is worth evening out.
+ * group_imbalanced: the tasks of the group are stuck behind affinity
+ *                   constraints, a higher domain must move one of them.
+ * group_overloaded: the group runs more tasks than it has cpus and they
+ *                   are actually waiting for them, the load is balanced.
+ */
+enum group_type {
+	group_has_spare = 0,
+	group_imbalanced,
+	group_overloaded,
+};
+
 /*
  * sd_lb_stats - Structure to store the statistics of a sched_domain
  * 		during load balancing.
@@ -4184,13 +5022,16 @@ struct sd_lb_stats {
 	unsigned long total_load;  /* Total load of all groups in sd */
 	unsigned long total_pwr;   /*	Total power of all groups in sd */
 	unsigned long avg_load;	   /* Average load across all groups in sd */
+	int prefer_sibling; /* Tasks should go to sibling first */
 
 	/** Statistics of this group */
 	unsigned long this_load;
 	unsigned long this_load_per_task;
 	unsigned long this_nr_running;
-	unsigned long this_has_capacity;
+	unsigned long this_util;
 	unsigned int  this_idle_cpus;
+	unsigned int  this_group_weight;
+	enum group_type this_group_type;
 
 	/* Statistics of the busiest group */
 	unsigned int  busiest_idle_cpus;
@@ -4198,10 +5039,7 @@ struct sd_lb_stats {
 	unsigned long busiest_load_per_task;
 	unsigned long busiest_nr_running;
 	unsigned long busiest_group_capacity;
-	unsigned long busiest_has_capacity;
-	unsigned int  busiest_group_weight;
-
-	int group_imb; /* Is there imbalance in this sd */
+	enum group_type busiest_group_type;
 };
 
 /*
@@ -4212,39 +5050,14 @@ struct sg_lb_stats {
 	unsigned long group_load; /* Total load over the CPUs of the group */
 	unsigned long sum_nr_running; /* Nr tasks running in the group */
 	unsigned long sum_weighted_load; /* Weighted load of group's tasks */
+	unsigned long group_util; /* Total utilization of the group */
 	unsigned long group_capacity;
 	unsigned long idle_cpus;
 	unsigned long group_weight;
 	int group_imb; /* Is there an imbalance in the group ? */
-	int group_has_capacity; /* Is there extra capacity in the group? */
+	enum group_type group_type;
 };
 
-/**
- * get_sd_load_idx - Obtain the load index for a given sched domain.
- * @sd: The sched_domain whose load_idx is to be obtained.
- * @idle: The Idle status of the CPU for whose sd load_icx is obtained.
- */
-static inline int get_sd_load_idx(struct sched_domain *sd,
-					enum cpu_idle_type idle)
-{
-	int load_idx;
-
-	switch (idle) {
-	case CPU_NOT_IDLE:
-		load_idx = sd->busy_idx;
-		break;
-
-	case CPU_NEWLY_IDLE:
-		load_idx = sd->newidle_idx;
-		break;
-	default:
-		load_idx = sd->idle_idx;
-		break;
-	}
-
-	return load_idx;
-}
-
 unsigned long default_scale_freq_power(struct sched_domain *sd, int cpu)
 {
 	return SCHED_POWER_SCALE;
@@ -4400,17 +5213,35 @@ fix_small_capacity(struct sched_domain *sd, struct sched_group *group)
 	return 0;
 }
 
+/*
+ * A group running more tasks than it has capacity for is only overloaded
+ * when its cpus are busy enough for those tasks to actually wait: a
+ * bunch of mostly sleeping tasks fits fine and is left alone.
+ */
+static inline enum group_type group_classify(struct lb_env *env,
+		struct sched_group *group, struct sg_lb_stats *sgs)
+{
+	if (sgs->sum_nr_running > sgs->group_capacity &&
+	    sgs->group_util * env->sd->imbalance_pct >
+			(unsigned long)group->sgp->power * 100)
+		return group_overloaded;
+
+	if (sgs->group_imb)
+		return group_imbalanced;
+
+	return group_has_spare;
+}
+
 /**
  * update_sg_lb_stats - Update sched_group's statistics for load balancing.
  * @env: The load balancing environment.
  * @group: sched_group whose statistics are to be updated.
- * @load_idx: Load index of sched_domain of this_cpu for load calc.
  * @local_group: Does group contain this_cpu.
  * @balance: Should we balance.
  * @sgs: variable to hold the statistics for this group.
  */
 static inline void update_sg_lb_stats(struct lb_env *env,
-			struct sched_group *group, int load_idx,
+			struct sched_group *group,
 			int local_group, int *balance, struct sg_lb_stats *sgs)
 {
 	unsigned long nr_running, max_nr_running, min_nr_running;
@@ -4432,6 +5263,7 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 		struct rq *rq = cpu_rq(i);
 
 		nr_running = rq->nr_running;
+		load = weighted_cpuload(i);
 
 		/* Bias balancing toward cpus of our domain */
 		if (local_group) {
@@ -4440,10 +5272,7 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 				first_idle_cpu = 1;
 				balance_cpu = i;
 			}
-
-			load = target_load(i, load_idx);
 		} else {
-			load = source_load(i, load_idx);
 			if (load > max_cpu_load)
 				max_cpu_load = load;
 			if (min_cpu_load > load)
@@ -4457,7 +5286,8 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 
 		sgs->group_load += load;
 		sgs->sum_nr_running += nr_running;
-		sgs->sum_weighted_load += weighted_cpuload(i);
+		sgs->sum_weighted_load += load;
+		sgs->group_util += cpu_utilization(i);
 		if (idle_cpu(i))
 			sgs->idle_cpus++;
 	}
@@ -4503,9 +5333,7 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 	if (!sgs->group_capacity)
 		sgs->group_capacity = fix_small_capacity(env->sd, group);
 	sgs->group_weight = group->group_weight;
-
-	if (sgs->group_capacity > sgs->sum_nr_running)
-		sgs->group_has_capacity = 1;
+	sgs->group_type = group_classify(env, group, sgs);
 }
 
 /**
@@ -4516,37 +5344,42 @@ static inline void update_sg_lb_stats(struct lb_env *env,
  * @sgs: sched_group statistics
  *
  * Determine if @sg is a busier group than the previously selected
- * busiest group.
+ * busiest group: the one with the highest group_type wins, ties are
+ * broken by load for the groups that need their load balanced and by
+ * the number of busy cpus and tasks for the others.
  */
 static bool update_sd_pick_busiest(struct lb_env *env,
 				   struct sd_lb_stats *sds,
 				   struct sched_group *sg,
 				   struct sg_lb_stats *sgs)
 {
-	if (sgs->avg_load <= sds->max_load)
+	if (!sgs->sum_nr_running)
 		return false;
 
-	if (sgs->sum_nr_running > sgs->group_capacity)
+	if (!sds->busiest || sgs->group_type > sds->busiest_group_type)
 		return true;
 
-	if (sgs->group_imb)
-		return true;
+	if (sgs->group_type < sds->busiest_group_type)
+		return false;
+
+	if (sgs->group_type != group_has_spare)
+		return sgs->avg_load > sds->max_load;
 
 	/*
 	 * ASYM_PACKING needs to move all the work to the lowest
 	 * numbered CPUs in the group, therefore mark all groups
 	 * higher than ourself as busy.
 	 */
-	if ((env->sd->flags & SD_ASYM_PACKING) && sgs->sum_nr_running &&
-	    env->dst_cpu < group_first_cpu(sg)) {
-		if (!sds->busiest)
-			return true;
+	if ((env->sd->flags & SD_ASYM_PACKING) &&
+	    env->dst_cpu < group_first_cpu(sg) &&
+	    group_first_cpu(sds->busiest) > group_first_cpu(sg))
+		return true;
 
-		if (group_first_cpu(sds->busiest) > group_first_cpu(sg))
-			return true;
-	}
+	/* Select the group with the fewest idle cpus, then the most tasks */
+	if (sgs->idle_cpus != sds->busiest_idle_cpus)
+		return sgs->idle_cpus < sds->busiest_idle_cpus;
 
-	return false;
+	return sgs->sum_nr_running > sds->busiest_nr_running;
 }
 
 /**
@@ -4561,19 +5394,16 @@ static inline void update_sd_lb_stats(struct lb_env *env,
 	struct sched_domain *child = env->sd->child;
 	struct sched_group *sg = env->sd->groups;
 	struct sg_lb_stats sgs;
-	int load_idx, prefer_sibling = 0;
 
 	if (child && child->flags & SD_PREFER_SIBLING)
-		prefer_sibling = 1;
-
-	load_idx = get_sd_load_idx(env->sd, env->idle);
+		sds->prefer_sibling = 1;
 
 	do {
 		int local_group;
 
 		local_group = cpumask_test_cpu(env->dst_cpu, sched_group_cpus(sg));
 		memset(&sgs, 0, sizeof(sgs));
-		update_sg_lb_stats(env, sg, load_idx, local_group, balance, &sgs);
+		update_sg_lb_stats(env, sg, local_group, balance, &sgs);
 
 		if (local_group && !(*balance))
 			return;
@@ -4581,26 +5411,15 @@ static inline void update_sd_lb_stats(struct lb_env *env,
 		sds->total_load += sgs.group_load;
 		sds->total_pwr += sg->sgp->power;
 
-		/*
-		 * In case the child domain prefers tasks go to siblings
-		 * first, lower the sg capacity to one so that we'll try
-		 * and move all the excess tasks away. We lower the capacity
-		 * of a group only if the local group has the capacity to fit
-		 * these excess tasks, i.e. nr_running < group_capacity. The
-		 * extra check prevents the case where you always pull from the
-		 * heaviest group when it is already under-utilized (possible
-		 * with a large weight task outweighs the tasks on the system).
-		 */
-		if (prefer_sibling && !local_group && sds->this_has_capacity)
-			sgs.group_capacity = min(sgs.group_capacity, 1UL);
-
 		if (local_group) {
 			sds->this_load = sgs.avg_load;
 			sds->this = sg;
 			sds->this_nr_running = sgs.sum_nr_running;
 			sds->this_load_per_task = sgs.sum_weighted_load;
-			sds->this_has_capacity = sgs.group_has_capacity;
+			sds->this_util = sgs.group_util;
 			sds->this_idle_cpus = sgs.idle_cpus;
+			sds->this_group_weight = sgs.group_weight;
+			sds->this_group_type = sgs.group_type;
 		} else if (update_sd_pick_busiest(env, sds, sg, &sgs)) {
 			sds->max_load = sgs.avg_load;
 			sds->busiest = sg;
@@ -4608,9 +5427,7 @@ static inline void update_sd_lb_stats(struct lb_env *env,
 			sds->busiest_idle_cpus = sgs.idle_cpus;
 			sds->busiest_group_capacity = sgs.group_capacity;
 			sds->busiest_load_per_task = sgs.sum_weighted_load;
-			sds->busiest_has_capacity = sgs.group_has_capacity;
-			sds->busiest_group_weight = sgs.group_weight;
-			sds->group_imb = sgs.group_imb;
+			sds->busiest_group_type = sgs.group_type;
 		}
 
 		sg = sg->next;
@@ -4654,6 +5471,7 @@ static int check_asym_packing(struct lb_env *env, struct sd_lb_stats *sds)
 	if (env->dst_cpu > busiest_cpu)
 		return 0;
 
+	env->migration_type = migrate_load;
 	env->imbalance = DIV_ROUND_CLOSEST(
 		sds->max_load * sds->busiest->sgp->power, SCHED_POWER_SCALE);
 
@@ -4738,14 +5556,55 @@ void fix_small_imbalance(struct lb_env *env, struct sd_lb_stats *sds)
  */
 static inline void calculate_imbalance(struct lb_env *env, struct sd_lb_stats *sds)
 {
-	unsigned long max_pull, load_above_capacity = ~0UL;
+	unsigned long max_pull, load_above_capacity;
 
-	sds->busiest_load_per_task /= sds->busiest_nr_running;
-	if (sds->group_imb) {
-		sds->busiest_load_per_task =
-			min(sds->busiest_load_per_task, sds->avg_load);
+	if (sds->busiest_group_type == group_imbalanced) {
+		/*
+		 * The load of the busiest group is stuck behind affinity
+		 * constraints, move any task that can go.
+		 */
+		env->migration_type = migrate_task;
+		env->imbalance = 1;
+		return;
+	}
+
+	if (sds->this_group_type == group_has_spare) {
+		if (sds->busiest_group_type == group_overloaded) {
+			/*
+			 * Fill the spare capacity of the local group with
+			 * the utilization of the waiting tasks.
+			 */
+			env->migration_type = migrate_util;
+			env->imbalance = max_t(unsigned long,
+					sds->this->sgp->power, sds->this_util);
+			env->imbalance -= sds->this_util;
+
+			/*
+			 * The local group looks busy because of tasks that
+			 * just left it: an idle cpu still pulls one task.
+			 */
+			if (!env->imbalance && env->idle != CPU_NOT_IDLE) {
+				env->migration_type = migrate_task;
+				env->imbalance = 1;
+			}
+			return;
+		}
+
+		/* Neither group is overloaded, even out the tasks */
+		env->migration_type = migrate_task;
+		if (sds->prefer_sibling || sds->this_group_weight == 1)
+			env->imbalance = (sds->busiest_nr_running -
+					  sds->this_nr_running) >> 1;
+		else
+			env->imbalance = (sds->this_idle_cpus -
+					  sds->busiest_idle_cpus) >> 1;
+		return;
 	}
 
+	/* Both groups are overloaded, balance their load */
+	env->migration_type = migrate_load;
+	sds->busiest_load_per_task /= sds->busiest_nr_running;
+
 	/*
 	 * In the presence of smp nice balancing, certain scenarios can have
 	 * max load less than avg load(as we skip the groups at or below
@@ -4756,17 +5615,15 @@ static inline void calculate_imbalance(struct lb_env *env, struct sd_lb_stats *s
 		return fix_small_imbalance(env, sds);
 	}
 
-	if (!sds->group_imb) {
-		/*
-		 * Don't want to pull so many tasks that a group would go idle.
-		 */
-		load_above_capacity = (sds->busiest_nr_running -
-						sds->busiest_group_capacity);
+	/*
+	 * Don't want to pull so many tasks that a group would go idle.
+	 */
+	load_above_capacity = (sds->busiest_nr_running -
+					sds->busiest_group_capacity);
 
-		load_above_capacity *= (SCHED_LOAD_SCALE * SCHED_POWER_SCALE);
+	load_above_capacity *= (SCHED_LOAD_SCALE * SCHED_POWER_SCALE);
 
-		load_above_capacity /= sds->busiest->sgp->power;
-	}
+	load_above_capacity /= sds->busiest->sgp->power;
 
 	/*
 	 * We're trying to get all the cpus to the average_load, so we don't
@@ -4852,44 +5709,60 @@ find_busiest_group(struct lb_env *env, int *balance)
 	 * work because they assumes all things are equal, which typically
 	 * isn't true due to cpus_allowed constraints and the like.
 	 */
-	if (sds.group_imb)
-		goto force_balance;
-
-	/* SD_BALANCE_NEWIDLE trumps SMP nice when underutilized */
-	if (env->idle == CPU_NEWLY_IDLE && sds.this_has_capacity &&
-			!sds.busiest_has_capacity)
+	if (sds.busiest_group_type == group_imbalanced)
 		goto force_balance;
 
 	/*
-	 * If the local group is more busy than the selected busiest group
-	 * don't try and pull any tasks.
+	 * If the local group is in a worse state than the selected busiest
+	 * group don't try and pull any tasks.
 	 */
-	if (sds.this_load >= sds.max_load)
+	if (sds.this_group_type > sds.busiest_group_type)
 		goto out_balanced;
 
+	if (sds.this_group_type == group_overloaded) {
+		/*
+		 * Both groups are overloaded. If the local group is more
+		 * busy than the busiest group or already above the domain
+		 * average load, don't pull any tasks.
+		 */
+		if (sds.this_load >= sds.max_load)
+			goto out_balanced;
+
+		if (sds.this_load >= sds.avg_load)
+			goto out_balanced;
+
+		/* Use imbalance_pct to be conservative */
+		if (100 * sds.max_load <= env->sd->imbalance_pct * sds.this_load)
+			goto out_balanced;
+
+		goto force_balance;
+	}
+
 	/*
-	 * Don't pull any tasks if this group is already above the domain
-	 * average load.
+	 * The local group has spare capacity for the waiting tasks. When its
+	 * utilization already fills it, only an idle cpu pulls: a busy one
+	 * would compute an empty imbalance, fail and end up active balancing
+	 * a running task into a group that has no room for it.
 	 */
-	if (sds.this_load >= sds.avg_load)
-		goto out_balanced;
+	if (sds.busiest_group_type == group_overloaded) {
+		if (env->idle == CPU_NOT_IDLE &&
+		    sds.this_util >= sds.this->sgp->power)
+			goto out_balanced;
+		goto force_balance;
+	}
 
-	if (env->idle == CPU_IDLE) {
-		/*
-		 * This cpu is idle. If the busiest group load doesn't
-		 * have more tasks than the number of available cpu's and
-		 * there is no imbalance between this and busiest group
-		 * wrt to idle cpu's, it is balanced.
-		 */
-		if ((sds.this_idle_cpus <= sds.busiest_idle_cpus + 1) &&
-		    sds.busiest_nr_running <= sds.busiest_group_weight)
+	/*
+	 * Neither group is overloaded, only spread the tasks when the
+	 * difference is worth a migration: for siblings or single cpu
+	 * groups by number of tasks, otherwise by number of idle cpus
+	 * seen from an idle cpu.
+	 */
+	if (sds.prefer_sibling || sds.this_group_weight == 1) {
+		if (sds.busiest_nr_running <= sds.this_nr_running + 1)
 			goto out_balanced;
 	} else {
-		/*
-		 * In the CPU_NEWLY_IDLE, CPU_NOT_IDLE cases, use
-		 * imbalance_pct to be conservative.
-		 */
-		if (100 * sds.max_load <= env->sd->imbalance_pct * sds.this_load)
+		if (env->idle == CPU_NOT_IDLE ||
+		    sds.this_idle_cpus <= sds.busiest_idle_cpus + 1)
 			goto out_balanced;
 	}
 
@@ -4911,7 +5784,8 @@ static struct rq *find_busiest_queue(struct lb_env *env,
 				     struct sched_group *group)
 {
 	struct rq *busiest = NULL, *rq;
-	unsigned long max_load = 0;
+	unsigned long max_load = 0, max_util = 0;
+	unsigned int max_nr_running = 0;
 	int i;
 
 	for_each_cpu(i, sched_group_cpus(group)) {
@@ -4927,26 +5801,55 @@ static struct rq *find_busiest_queue(struct lb_env *env,
 			continue;
 
 		rq = cpu_rq(i);
-		wl = weighted_cpuload(i);
 
-		/*
-		 * When comparing with imbalance, use weighted_cpuload()
-		 * which is not scaled with the cpu power.
-		 */
-		if (capacity && rq->nr_running == 1 && wl > env->imbalance)
-			continue;
+		switch (env->migration_type) {
+		case migrate_load:
+			wl = weighted_cpuload(i);
 
-		/*
-		 * For the load comparisons with the other cpu's, consider
-		 * the weighted_cpuload() scaled with the cpu power, so that
-		 * the load can be moved away from the cpu that is potentially
-		 * running at a lower capacity.
-		 */
-		wl = (wl * SCHED_POWER_SCALE) / power;
+			/*
+			 * When comparing with imbalance, use weighted_cpuload()
+			 * which is not scaled with the cpu power.
+			 */
+			if (capacity && rq->nr_running == 1 &&
+			    wl > env->imbalance)
+				continue;
+
+			/*
+			 * For the load comparisons with the other cpu's,
+			 * consider the weighted_cpuload() scaled with the cpu
+			 * power, so that the load can be moved away from the
+			 * cpu that is potentially running at a lower capacity.
+			 */
+			wl = (wl * SCHED_POWER_SCALE) / power;
+
+			if (wl > max_load) {
+				max_load = wl;
+				busiest = rq;
+			}
+			break;
+
+		case migrate_util:
+			/*
+			 * Only a cpu with waiting tasks has utilization to
+			 * give away, its single task would just move the
+			 * overload.
+			 */
+			if (rq->nr_running <= 1)
+				continue;
+
+			wl = cpu_utilization(i);
+			if (wl > max_util) {
+				max_util = wl;
+				busiest = rq;
+			}
+			break;
 
-		if (wl > max_load) {
-			max_load = wl;
-			busiest = rq;
+		case migrate_task:
+			if (rq->nr_running > max_nr_running) {
+				max_nr_running = rq->nr_running;
+				busiest = rq;
+			}
+			break;
 		}
 	}
 
@@ -5816,7 +6719,7 @@ static void switched_from_fair(struct rq *rq, struct task_struct *p)
 		se->vruntime -= cfs_rq->min_vruntime;
 	}
 
-#if defined(CONFIG_FAIR_GROUP_SCHED) && defined(CONFIG_SMP)
+#ifdef CONFIG_SMP
 	/*
 	* Remove our load from contribution when we leave sched_fair
 	* and ensure we don't carry in an old decay_count if we
@@ -5875,7 +6778,7 @@ void init_cfs_rq(struct cfs_rq *cfs_rq)
 #ifndef CONFIG_64BIT
 	cfs_rq->min_vruntime_copy = cfs_rq->min_vruntime;
 #endif
-#if defined(CONFIG_FAIR_GROUP_SCHED) && defined(CONFIG_SMP)
+#ifdef CONFIG_SMP
 	atomic64_set(&cfs_rq->decay_counter, 1);
 	atomic64_set(&cfs_rq->removed_load, 0);
 #endif
@@ -6114,9 +7017,7 @@ const struct sched_class fair_sched_class = {
 
 #ifdef CONFIG_SMP
 	.select_task_rq		= select_task_rq_fair,
-#ifdef CONFIG_FAIR_GROUP_SCHED
 	.migrate_task_rq	= migrate_task_rq_fair,
-#endif
 	.rq_online		= rq_online_fair,
 	.rq_offline		= rq_offline_fair,
 
@@ -6124,6 +7025,7 @@ const struct sched_class fair_sched_class = {
 #endif
 
 	.set_curr_task          = set_curr_task_fair,
+	.update_curr		= update_curr_fair,
 	.task_tick		= task_tick_fair,
 	.task_fork		= task_fork_fair,
 
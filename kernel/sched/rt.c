@@ -6,6 +6,7 @@
 #include "sched.h"
 
 #include <linux/slab.h>
+#include <linux/posix-timers.h>
 
 int sched_rr_timeslice = RR_TIMESLICE;
 
@@ -1995,8 +1996,11 @@ static void watchdog(struct rq *rq, struct task_struct *p)
 		}
 
 		next = DIV_ROUND_UP(min(soft, hard), USEC_PER_SEC/HZ);
-		if (p->rt.timeout > next)
+		if (p->rt.timeout > next) {
 			p->cputime_expires.sched_exp = p->se.sum_exec_runtime;
+			/* The rq lock is held and @p runs there */
+			posix_cpu_timers_kick_cpu(cpu_of(rq));
+		}
 	}
 }
 
@@ -2078,6 +2082,7 @@ const struct sched_class rt_sched_class = {
 #endif
 
 	.set_curr_task          = set_curr_task_rt,
+	.update_curr		= update_curr_rt,
 	.task_tick		= task_tick_rt,
 
 	.get_rr_interval	= get_rr_interval_rt,
@@ -2,9 +2,11 @@
 #include <linux/sched.h>
 #include <linux/sched/sysctl.h>
 #include <linux/sched/rt.h>
+#include <linux/sched/deadline.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 #include "cpupri.h"
 
@@ -57,6 +59,45 @@ static inline int task_has_rt_policy(struct task_struct *p)
 	return rt_policy(p->policy);
 }
 
+static inline int dl_policy(int policy)
+{
+	return unlikely(policy == SCHED_DEADLINE);
+}
+
+static inline int task_has_dl_policy(struct task_struct *p)
+{
+	return dl_policy(p->policy);
+}
+
+static inline int fair_policy(int policy)
+{
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
+}
+
+/*
+ * SCHED_DEADLINE time comparisons are wrap safe, as for jiffies.
+ */
+static inline bool dl_time_before(u64 a, u64 b)
+{
+	return (s64)(a - b) < 0;
+}
+
+/*
+ * Tells if entity @a should preempt entity @b: earliest deadline first.
+ */
+static inline bool
+dl_entity_preempt(struct sched_dl_entity *a, struct sched_dl_entity *b)
+{
+	return dl_time_before(a->deadline, b->deadline);
+}
+
+/*
+ * The SCHED_DEADLINE computations that don't need nanosecond
+ * precision scale the values down by 2^DL_SCALE, i.e. to ~1us,
+ * which is also the smallest runtime accepted.
+ */
+#define DL_SCALE		10
+
 /*
  * This is the priority-queue data structure of the RT scheduling class:
  */
@@ -88,9 +129,13 @@ struct cfs_bandwidth {
 #ifdef CONFIG_CFS_BANDWIDTH
 	raw_spinlock_t lock;
 	ktime_t period;
-	u64 quota, runtime;
+	u64 quota, burst;
+	/*
+	 * Global runtime pool, cfs_rqs refill their local runtime from it
+	 * with cmpxchg so that cfs_b->lock stays off the accounting path.
+	 */
+	atomic64_t runtime;
 	s64 hierarchal_quota;
-	u64 runtime_expires;
 
 	int idle, timer_active;
 	struct hrtimer period_timer, slack_timer;
@@ -227,12 +272,6 @@ struct cfs_rq {
 #endif
 
 #ifdef CONFIG_SMP
-/*
- * Load-tracking only depends on SMP, FAIR_GROUP_SCHED dependency below may be
- * removed when useful for applications beyond shares distribution (e.g.
- * load-balance).
- */
-#ifdef CONFIG_FAIR_GROUP_SCHED
 	/*
 	 * CFS Load tracking
 	 * Under CFS, load is tracked on a per-entity basis and aggregated up.
@@ -242,7 +281,11 @@ struct cfs_rq {
 	u64 runnable_load_avg, blocked_load_avg;
 	atomic64_t decay_counter, removed_load;
 	u64 last_decay;
-#endif /* CONFIG_FAIR_GROUP_SCHED */
+	/*
+	 * Utilization of the runnable entities, the part of the cpu
+	 * capacity they use, in SCHED_POWER_SCALE units.
+	 */
+	unsigned long utilization_load_avg;
 /* These always depend on CONFIG_FAIR_GROUP_SCHED */
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	u32 tg_runnable_contrib;
@@ -275,7 +318,6 @@ struct cfs_rq {
 
 #ifdef CONFIG_CFS_BANDWIDTH
 	int runtime_enabled;
-	u64 runtime_expires;
 	s64 runtime_remaining;
 
 	u64 throttled_clock, throttled_clock_task;
@@ -291,6 +333,15 @@ static inline int rt_bandwidth_enabled(void)
 	return sysctl_sched_rt_runtime >= 0;
 }
 
+/*
+ * The deadline tasks are admitted within the same global bandwidth as
+ * the RT tasks, there is no admission control when it is unlimited.
+ */
+static inline int dl_bandwidth_enabled(void)
+{
+	return sysctl_sched_rt_runtime >= 0;
+}
+
 /* Real-Time classes' related field in a runqueue: */
 struct rt_rq {
 	struct rt_prio_array active;
@@ -324,6 +375,65 @@ struct rt_rq {
 #endif
 };
 
+/*
+ * SCHED_DEADLINE admission control: the bandwidth (runtime / period,
+ * as computed by to_ratio()) allowed on each CPU and the sum of the
+ * bandwidths reserved by the deadline tasks. A bw of -1 means no
+ * limit. It is tracked per root domain, or per runqueue on UP.
+ */
+struct dl_bw {
+	raw_spinlock_t lock;
+	u64 bw, total_bw;
+	/* total_bw is being recomputed, see dl_rebuild_root_domains_bw() */
+	int rebuilding;
+};
+
+extern unsigned int dl_rebuild_gen;
+
+/* requires dl_b->lock */
+static inline void __dl_clear(struct dl_bw *dl_b, u64 tsk_bw)
+{
+	/* total_bw is a sum of admitted tasks, it can never go negative */
+	if (WARN_ON(dl_b->total_bw < tsk_bw))
+		dl_b->total_bw = 0;
+	else
+		dl_b->total_bw -= tsk_bw;
+}
+
+/* Deadline class' related fields in a runqueue: */
+struct dl_rq {
+	/* runqueue is an rbtree, ordered by deadline */
+	struct rb_root rb_root;
+	struct rb_node *rb_leftmost;
+
+	unsigned long dl_nr_running;
+
+#ifdef CONFIG_SMP
+	/*
+	 * Earliest deadline queued on this rq (curr) and earliest
+	 * deadline of the tasks that could be pushed away (next),
+	 * 0 if none. Like the rt highest_prio, they are read without
+	 * the rq lock by the push and pull decisions.
+	 */
+	struct {
+		u64 curr;
+		u64 next;
+	} earliest_dl;
+
+	unsigned long dl_nr_migratory;
+	int overloaded;
+
+	/*
+	 * Tasks on this rq that can be pushed away, in an rbtree
+	 * ordered by deadline with the leftmost node cached.
+	 */
+	struct rb_root pushable_dl_tasks_root;
+	struct rb_node *pushable_dl_tasks_leftmost;
+#else
+	struct dl_bw dl_bw;
+#endif
+};
+
 #ifdef CONFIG_SMP
 
 /*
@@ -347,6 +457,14 @@ struct root_domain {
 	 */
 	cpumask_var_t rto_mask;
 	struct cpupri cpupri;
+
+	/*
+	 * The "deadline overload" flag: it gets set if a CPU has more
+	 * than one runnable deadline task.
+	 */
+	cpumask_var_t dlo_mask;
+	atomic_t dlo_count;
+	struct dl_bw dl_bw;
 };
 
 extern struct root_domain def_root_domain;
@@ -375,6 +493,9 @@ struct rq {
 #ifdef CONFIG_NO_HZ
 	u64 nohz_stamp;
 	unsigned long nohz_flags;
+#endif
+#ifdef CONFIG_NO_HZ_FULL
+	unsigned long last_sched_tick;
 #endif
 	int skip_clock_update;
 
@@ -385,6 +506,7 @@ struct rq {
 
 	struct cfs_rq cfs;
 	struct rt_rq rt;
+	struct dl_rq dl;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
@@ -503,6 +625,47 @@ DECLARE_PER_CPU(struct rq, runqueues);
 #define cpu_curr(cpu)		(cpu_rq(cpu)->curr)
 #define raw_rq()		(&__raw_get_cpu_var(runqueues))
 
+#ifdef CONFIG_SMP
+static inline struct dl_bw *dl_bw_of(int cpu)
+{
+	return &cpu_rq(cpu)->rd->dl_bw;
+}
+
+/* The CPUs sharing the bandwidth of @cpu's root domain */
+static inline int dl_bw_cpus(int cpu)
+{
+	struct root_domain *rd = cpu_rq(cpu)->rd;
+	int i, cpus = 0;
+
+	for_each_cpu_and(i, rd->span, cpu_active_mask)
+		cpus++;
+
+	return cpus;
+}
+
+/* Root domains are visited once, through their first online cpu */
+static inline bool dl_bw_first_cpu(int cpu)
+{
+	return cpu == cpumask_first_and(cpu_rq(cpu)->rd->span,
+					cpu_online_mask);
+}
+#else
+static inline struct dl_bw *dl_bw_of(int cpu)
+{
+	return &cpu_rq(cpu)->dl.dl_bw;
+}
+
+static inline int dl_bw_cpus(int cpu)
+{
+	return 1;
+}
+
+static inline bool dl_bw_first_cpu(int cpu)
+{
+	return true;
+}
+#endif
+
 #ifdef CONFIG_SMP
 
 #define rcu_dereference_check_sched_domain(p) \
@@ -546,11 +709,25 @@ static inline struct sched_domain *highest_flag_domain(int cpu, int flag)
 
 DECLARE_PER_CPU(struct sched_domain *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_id);
+DECLARE_PER_CPU(struct sched_domain_shared *, sd_llc_shared);
 
 extern int group_balance_cpu(struct sched_group *sg);
 
 #endif /* CONFIG_SMP */
 
+#ifdef CONFIG_SCHED_SMT
+static inline const struct cpumask *cpu_smt_mask(int cpu)
+{
+	return topology_thread_cpumask(cpu);
+}
+
+extern void update_idle_core(struct rq *rq);
+extern void clear_idle_core(struct rq *rq);
+#else
+static inline void update_idle_core(struct rq *rq) { }
+static inline void clear_idle_core(struct rq *rq) { }
+#endif
+
 #include "stats.h"
 #include "auto_group.h"
 
@@ -672,6 +849,15 @@ extern struct static_key sched_feat_keys[__SCHED_FEAT_NR];
 #else
 extern bool numabalancing_enabled;
 #endif /* CONFIG_SCHED_DEBUG */
+
+extern int migrate_task_to(struct task_struct *p, int cpu);
+extern int migrate_swap(struct task_struct *p, struct task_struct *t);
+
+/* Index of the shared (priv == 0) or private fault counter of @nid */
+static inline int task_faults_idx(int nid, int priv)
+{
+	return 2 * nid + priv;
+}
 #else
 #define sched_feat_numa(x) (0)
 #define numabalancing_enabled (0)
@@ -870,6 +1056,7 @@ enum cpuacct_stat_index {
    for (class = sched_class_highest; class; class = class->next)
 
 extern const struct sched_class stop_sched_class;
+extern const struct sched_class dl_sched_class;
 extern const struct sched_class rt_sched_class;
 extern const struct sched_class fair_sched_class;
 extern const struct sched_class idle_sched_class;
@@ -894,6 +1081,7 @@ extern void update_max_interval(void);
 extern void update_group_power(struct sched_domain *sd, int cpu);
 extern int update_runtime(struct notifier_block *nfb, unsigned long action, void *hcpu);
 extern void init_sched_rt_class(void);
+extern void init_sched_dl_class(void);
 extern void init_sched_fair_class(void);
 
 extern void resched_task(struct task_struct *p);
@@ -901,6 +1089,8 @@ extern void resched_cpu(int cpu);
 
 extern struct rt_bandwidth def_rt_bandwidth;
 extern void init_rt_bandwidth(struct rt_bandwidth *rt_b, u64 period, u64 runtime);
+extern void init_dl_bw(struct dl_bw *dl_b);
+extern void init_dl_task_timer(struct sched_dl_entity *dl_se);
 
 extern void update_idle_cpu_load(struct rq *this_rq);
 
@@ -953,14 +1143,63 @@ static inline u64 steal_ticks(u64 steal)
 }
 #endif
 
+#ifdef CONFIG_NO_HZ_FULL
+static inline bool sched_can_stop_tick(struct rq *rq)
+{
+	/* Deadline tasks need the tick to enforce their runtime */
+	if (rq->dl.dl_nr_running)
+		return false;
+
+	/* More than one running task need preemption */
+	return rq->nr_running <= 1;
+}
+
+/*
+ * Declare or release the scheduler dependency on the tick of a full
+ * dynticks CPU as its runqueue crosses the single task boundary.
+ */
+static inline void sched_update_tick_dependency(struct rq *rq)
+{
+	int cpu;
+
+	if (!tick_nohz_full_enabled())
+		return;
+
+	cpu = cpu_of(rq);
+
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	if (sched_can_stop_tick(rq))
+		tick_nohz_dep_clear_cpu(cpu, TICK_DEP_BIT_SCHED);
+	else
+		tick_nohz_dep_set_cpu(cpu, TICK_DEP_BIT_SCHED);
+}
+#else
+static inline void sched_update_tick_dependency(struct rq *rq) { }
+#endif
+
 static inline void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
+
+	if (rq->nr_running == 2)
+		sched_update_tick_dependency(rq);
 }
 
 static inline void dec_nr_running(struct rq *rq)
 {
 	rq->nr_running--;
+
+	if (rq->nr_running == 1)
+		sched_update_tick_dependency(rq);
+}
+
+static inline void rq_last_tick_reset(struct rq *rq)
+{
+#ifdef CONFIG_NO_HZ_FULL
+	rq->last_sched_tick = jiffies;
+#endif
 }
 
 extern void update_rq_clock(struct rq *rq);
@@ -1180,6 +1419,7 @@ extern void print_rt_stats(struct seq_file *m, int cpu);
 
 extern void init_cfs_rq(struct cfs_rq *cfs_rq);
 extern void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq);
+extern void init_dl_rq(struct dl_rq *dl_rq, struct rq *rq);
 
 extern void account_cfs_bandwidth_used(int enabled, int was_enabled);
 
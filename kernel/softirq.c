@@ -22,6 +22,7 @@
 #include <linux/kthread.h>
 #include <linux/rcupdate.h>
 #include <linux/ftrace.h>
+#include <linux/irq_work.h>
 #include <linux/smp.h>
 #include <linux/smpboot.h>
 #include <linux/tick.h>
@@ -342,6 +343,11 @@ static inline void invoke_softirq(void)
  */
 void irq_exit(void)
 {
+#ifdef CONFIG_NO_HZ
+	/* Nothing else runs the lazy irq works while the tick is stopped */
+	if (tick_nohz_tick_stopped())
+		irq_work_run_lazy();
+#endif
 	account_irq_exit_time(current);
 	trace_hardirq_exit();
 	sub_preempt_count(IRQ_EXIT_OFFSET);
@@ -349,9 +355,17 @@ void irq_exit(void)
 		invoke_softirq();
 
 #ifdef CONFIG_NO_HZ
-	/* Make sure that timer wheel updates are propagated */
-	if (idle_cpu(smp_processor_id()) && !in_interrupt() && !need_resched())
-		tick_nohz_irq_exit();
+	/*
+	 * Make sure that timer wheel updates are propagated and give
+	 * full dynticks CPUs a chance to stop their tick.
+	 */
+	if (!in_interrupt()) {
+		int cpu = smp_processor_id();
+
+		if ((idle_cpu(cpu) && !need_resched()) ||
+		    tick_nohz_full_cpu(cpu))
+			tick_nohz_irq_exit();
+	}
 #endif
 	rcu_irq_exit();
 	sched_preempt_enable_no_resched();
@@ -34,6 +34,9 @@
 #include <linux/sched.h>
 #include <linux/smp.h>
 #include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/srcu.h>
 
 #include <trace/events/rcu.h>
@@ -98,18 +101,226 @@ static inline void rcu_batch_move(struct rcu_batch *to, struct rcu_batch *from)
 	}
 }
 
+/*
+ * The SRCU grace-period sequence number: the low-order bits hold the
+ * phase of the current grace period, the upper bits count the grace
+ * periods.  A grace period is needed by a callback queued at sequence
+ * number s once the counter reaches srcu_seq_snap(s).
+ */
+#define SRCU_STATE_IDLE		0
+#define SRCU_STATE_SCAN1	1
+#define SRCU_STATE_SCAN2	2
+
+#define SRCU_SEQ_CTR_SHIFT	2
+#define SRCU_SEQ_STATE_MASK	((1 << SRCU_SEQ_CTR_SHIFT) - 1)
+
+/* Return the counter portion of a sequence number. */
+static inline unsigned long srcu_seq_ctr(unsigned long s)
+{
+	return s >> SRCU_SEQ_CTR_SHIFT;
+}
+
+/* Return the state portion of a sequence number. */
+static inline int srcu_seq_state(unsigned long s)
+{
+	return s & SRCU_SEQ_STATE_MASK;
+}
+
+/* Set the state portion of the pointed-to sequence number. */
+static inline void srcu_seq_set_state(unsigned long *sp, int newstate)
+{
+	ACCESS_ONCE(*sp) = (*sp & ~SRCU_SEQ_STATE_MASK) + newstate;
+}
+
+/* Adjust sequence number for start of update-side operation. */
+static inline void srcu_seq_start(unsigned long *sp)
+{
+	ACCESS_ONCE(*sp) = *sp + 1;
+	smp_mb(); /* Ensure update-side operation after counter increment. */
+	WARN_ON_ONCE(srcu_seq_state(*sp) != SRCU_STATE_SCAN1);
+}
+
+/* Adjust sequence number for end of update-side operation. */
+static inline void srcu_seq_end(unsigned long *sp)
+{
+	smp_mb(); /* Ensure update-side operation before counter increment. */
+	WARN_ON_ONCE(!srcu_seq_state(*sp));
+	ACCESS_ONCE(*sp) = (*sp | SRCU_SEQ_STATE_MASK) + 1;
+}
+
+/* Take a snapshot of the update side's sequence number. */
+static inline unsigned long srcu_seq_snap(unsigned long *sp)
+{
+	unsigned long s;
+
+	s = (ACCESS_ONCE(*sp) + 2 * SRCU_SEQ_STATE_MASK + 1) &
+	    ~SRCU_SEQ_STATE_MASK;
+	smp_mb(); /* Above access must not bleed into critical section. */
+	return s;
+}
+
+/* Return the current value of the update side's sequence number. */
+static inline unsigned long srcu_seq_current(unsigned long *sp)
+{
+	unsigned long s = ACCESS_ONCE(*sp);
+
+	smp_mb(); /* Above access must not bleed into critical section. */
+	return s;
+}
+
+/* Has a full update-side operation elapsed since the snapshot s? */
+static inline bool srcu_seq_done(unsigned long *sp, unsigned long s)
+{
+	return ULONG_CMP_GE(ACCESS_ONCE(*sp), s);
+}
+
+/*
+ * Move the callbacks of the specified srcu_data structure whose grace
+ * period has elapsed to ->batch_done, and the ->batch_next callbacks to
+ * ->batch_wait when the latter is empty.
+ */
+static void srcu_cblist_advance(struct srcu_data *sdp, unsigned long gpseq)
+{
+	if (!rcu_batch_empty(&sdp->batch_wait) &&
+	    ULONG_CMP_GE(gpseq, sdp->gp_seq_wait))
+		rcu_batch_move(&sdp->batch_done, &sdp->batch_wait);
+	if (!rcu_batch_empty(&sdp->batch_next) &&
+	    rcu_batch_empty(&sdp->batch_wait)) {
+		if (ULONG_CMP_GE(gpseq, sdp->gp_seq_next)) {
+			rcu_batch_move(&sdp->batch_done, &sdp->batch_next);
+		} else {
+			rcu_batch_move(&sdp->batch_wait, &sdp->batch_next);
+			sdp->gp_seq_wait = sdp->gp_seq_next;
+		}
+	}
+}
+
+/*
+ * Enqueue a callback that needs the grace period s.  Batches are only
+ * ever appended to, so a callback that lands behind callbacks waiting
+ * for a later grace period waits for that one as well.
+ */
+static void srcu_cblist_enqueue(struct srcu_data *sdp, struct rcu_head *head,
+				unsigned long s)
+{
+	if (rcu_batch_empty(&sdp->batch_next) &&
+	    (rcu_batch_empty(&sdp->batch_wait) || sdp->gp_seq_wait == s)) {
+		rcu_batch_queue(&sdp->batch_wait, head);
+		sdp->gp_seq_wait = s;
+		return;
+	}
+	if (rcu_batch_empty(&sdp->batch_next) ||
+	    ULONG_CMP_LT(sdp->gp_seq_next, s))
+		sdp->gp_seq_next = s;
+	rcu_batch_queue(&sdp->batch_next, head);
+}
+
+/*
+ * Queue a callback behind all the callbacks of the specified srcu_data
+ * structure, including those being invoked, returning false if there
+ * are none.
+ */
+static bool srcu_cblist_entrain(struct srcu_data *sdp, struct rcu_head *head)
+{
+	if (!rcu_batch_empty(&sdp->batch_next))
+		rcu_batch_queue(&sdp->batch_next, head);
+	else if (!rcu_batch_empty(&sdp->batch_wait))
+		rcu_batch_queue(&sdp->batch_wait, head);
+	else if (!rcu_batch_empty(&sdp->batch_done) ||
+		 sdp->srcu_cblist_invoking)
+		rcu_batch_queue(&sdp->batch_done, head);
+	else
+		return false;
+	return true;
+}
+
+static void srcu_invoke_callbacks(struct work_struct *work);
+
+/*
+ * Initialize the srcu_node and srcu_data structures of the specified
+ * srcu_struct.
+ */
+static void init_srcu_struct_nodes(struct srcu_struct *sp)
+{
+	int cpu;
+	int i;
+	struct srcu_data *sdp;
+	struct srcu_node *snp;
+
+	sp->srcu_num_nodes = DIV_ROUND_UP(nr_cpu_ids, SRCU_FANOUT_LEAF);
+	for (i = 0; i < sp->srcu_num_nodes; i++) {
+		snp = &sp->node[i];
+		spin_lock_init(&snp->lock);
+		memset(snp->srcu_have_cbs, 0, sizeof(snp->srcu_have_cbs));
+		memset(snp->srcu_data_have_cbs, 0,
+		       sizeof(snp->srcu_data_have_cbs));
+		snp->srcu_gp_seq_needed_exp = 0;
+		snp->grplo = i * SRCU_FANOUT_LEAF;
+	}
+
+	for_each_possible_cpu(cpu) {
+		sdp = per_cpu_ptr(sp->sda, cpu);
+		spin_lock_init(&sdp->lock);
+		rcu_batch_init(&sdp->batch_done);
+		rcu_batch_init(&sdp->batch_wait);
+		rcu_batch_init(&sdp->batch_next);
+		sdp->srcu_gp_seq_needed = sp->srcu_gp_seq;
+		sdp->srcu_gp_seq_needed_exp = sp->srcu_gp_seq;
+		sdp->srcu_cblist_invoking = false;
+		INIT_DELAYED_WORK(&sdp->work, srcu_invoke_callbacks);
+		sdp->mynode = &sp->node[cpu / SRCU_FANOUT_LEAF];
+		sdp->grpmask = 1UL << (cpu % SRCU_FANOUT_LEAF);
+		sdp->cpu = cpu;
+		sdp->sp = sp;
+	}
+}
+
 static int init_srcu_struct_fields(struct srcu_struct *sp)
 {
 	sp->completed = 0;
-	spin_lock_init(&sp->queue_lock);
-	sp->running = false;
-	rcu_batch_init(&sp->batch_queue);
-	rcu_batch_init(&sp->batch_check0);
-	rcu_batch_init(&sp->batch_check1);
-	rcu_batch_init(&sp->batch_done);
+	spin_lock_init(&sp->lock);
+	mutex_init(&sp->srcu_cb_mutex);
+	mutex_init(&sp->srcu_gp_mutex);
+	mutex_init(&sp->srcu_barrier_mutex);
+	sp->srcu_gp_seq = 0;
+	sp->srcu_gp_seq_needed = 0;
+	sp->srcu_gp_seq_needed_exp = 0;
+	sp->srcu_last_gp_end = 0;
 	INIT_DELAYED_WORK(&sp->work, process_srcu);
-	sp->per_cpu_ref = alloc_percpu(struct srcu_struct_array);
-	return sp->per_cpu_ref ? 0 : -ENOMEM;
+	sp->sda = alloc_percpu(struct srcu_data);
+	sp->node = kcalloc(DIV_ROUND_UP(nr_cpu_ids, SRCU_FANOUT_LEAF),
+			   sizeof(*sp->node), GFP_KERNEL);
+	if (!sp->sda || !sp->node) {
+		free_percpu(sp->sda);
+		kfree(sp->node);
+		sp->sda = NULL;
+		sp->node = NULL;
+		return -ENOMEM;
+	}
+	init_srcu_struct_nodes(sp);
+	sp->srcu_initialized = true;
+	return 0;
+}
+
+/*
+ * First-use initialization of a statically allocated srcu_struct, whose
+ * per-CPU data cannot be fully set up at build time.
+ */
+static void check_init_srcu_struct(struct srcu_struct *sp)
+{
+	unsigned long flags;
+
+	if (likely(ACCESS_ONCE(sp->srcu_initialized))) {
+		smp_rmb(); /* Initialization before use. */
+		return;
+	}
+	spin_lock_irqsave(&sp->lock, flags);
+	if (!sp->srcu_initialized) {
+		init_srcu_struct_nodes(sp);
+		smp_wmb(); /* Initialization before ->srcu_initialized. */
+		ACCESS_ONCE(sp->srcu_initialized) = true;
+	}
+	spin_unlock_irqrestore(&sp->lock, flags);
 }
 
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
@@ -153,7 +364,7 @@ static unsigned long srcu_readers_seq_idx(struct srcu_struct *sp, int idx)
 	unsigned long t;
 
 	for_each_possible_cpu(cpu) {
-		t = ACCESS_ONCE(per_cpu_ptr(sp->per_cpu_ref, cpu)->seq[idx]);
+		t = ACCESS_ONCE(per_cpu_ptr(sp->sda, cpu)->seq[idx]);
 		sum += t;
 	}
 	return sum;
@@ -170,7 +381,7 @@ static unsigned long srcu_readers_active_idx(struct srcu_struct *sp, int idx)
 	unsigned long t;
 
 	for_each_possible_cpu(cpu) {
-		t = ACCESS_ONCE(per_cpu_ptr(sp->per_cpu_ref, cpu)->c[idx]);
+		t = ACCESS_ONCE(per_cpu_ptr(sp->sda, cpu)->c[idx]);
 		sum += t;
 	}
 	return sum;
@@ -267,8 +478,8 @@ static int srcu_readers_active(struct srcu_struct *sp)
 	unsigned long sum = 0;
 
 	for_each_possible_cpu(cpu) {
-		sum += ACCESS_ONCE(per_cpu_ptr(sp->per_cpu_ref, cpu)->c[0]);
-		sum += ACCESS_ONCE(per_cpu_ptr(sp->per_cpu_ref, cpu)->c[1]);
+		sum += ACCESS_ONCE(per_cpu_ptr(sp->sda, cpu)->c[0]);
+		sum += ACCESS_ONCE(per_cpu_ptr(sp->sda, cpu)->c[1]);
 	}
 	return sum;
 }
@@ -282,10 +493,20 @@ static int srcu_readers_active(struct srcu_struct *sp)
  */
 void cleanup_srcu_struct(struct srcu_struct *sp)
 {
+	int cpu;
+
 	if (WARN_ON(srcu_readers_active(sp)))
 		return; /* Leakage unless caller handles error. */
-	free_percpu(sp->per_cpu_ref);
-	sp->per_cpu_ref = NULL;
+	flush_delayed_work(&sp->work);
+	for_each_possible_cpu(cpu)
+		flush_delayed_work(&per_cpu_ptr(sp->sda, cpu)->work);
+	if (WARN_ON(srcu_seq_state(ACCESS_ONCE(sp->srcu_gp_seq))) ||
+	    WARN_ON(ULONG_CMP_LT(sp->srcu_gp_seq, sp->srcu_gp_seq_needed)))
+		return; /* Caller forgot to stop doing call_srcu()? */
+	free_percpu(sp->sda);
+	sp->sda = NULL;
+	kfree(sp->node);
+	sp->node = NULL;
 }
 EXPORT_SYMBOL_GPL(cleanup_srcu_struct);
 
@@ -300,9 +521,9 @@ int __srcu_read_lock(struct srcu_struct *sp)
 
 	idx = ACCESS_ONCE(sp->completed) & 0x1;
 	preempt_disable();
-	ACCESS_ONCE(this_cpu_ptr(sp->per_cpu_ref)->c[idx]) += 1;
+	ACCESS_ONCE(this_cpu_ptr(sp->sda)->c[idx]) += 1;
 	smp_mb(); /* B */  /* Avoid leaking the critical section. */
-	ACCESS_ONCE(this_cpu_ptr(sp->per_cpu_ref)->seq[idx]) += 1;
+	ACCESS_ONCE(this_cpu_ptr(sp->sda)->seq[idx]) += 1;
 	preempt_enable();
 	return idx;
 }
@@ -317,7 +538,7 @@ EXPORT_SYMBOL_GPL(__srcu_read_lock);
 void __srcu_read_unlock(struct srcu_struct *sp, int idx)
 {
 	smp_mb(); /* C */  /* Avoid leaking the critical section. */
-	this_cpu_dec(sp->per_cpu_ref->c[idx]);
+	this_cpu_dec(sp->sda->c[idx]);
 }
 EXPORT_SYMBOL_GPL(__srcu_read_unlock);
 
@@ -326,12 +547,21 @@ EXPORT_SYMBOL_GPL(__srcu_read_unlock);
  * synchronize_srcu_expedited().  We spin for a fixed time period
  * (defined below) to allow SRCU readers to exit their read-side critical
  * sections.  If there are still some readers after 10 microseconds,
- * we repeatedly block for 1-millisecond time periods.  This approach
- * has done well in testing, so there is no need for a config parameter.
+ * the grace-period work retries every SRCU_INTERVAL, or right away when
+ * an expedited grace period is needed.  This approach has done well in
+ * testing, so there is no need for a config parameter.
  */
 #define SRCU_RETRY_CHECK_DELAY		5
 #define SYNCHRONIZE_SRCU_TRYCOUNT	2
 #define SYNCHRONIZE_SRCU_EXP_TRYCOUNT	12
+#define SRCU_INTERVAL			1
+
+/*
+ * Don't auto-expedite a synchronize_srcu() that comes less than this
+ * many nanoseconds after the end of the previous grace period.
+ */
+static ulong exp_holdoff = 25 * 1000;
+module_param(exp_holdoff, ulong, 0444);
 
 /*
  * @@@ Wait until all pre-existing readers complete.  Such readers
@@ -357,27 +587,238 @@ static bool try_check_zero(struct srcu_struct *sp, int idx, int trycount)
  */
 static void srcu_flip(struct srcu_struct *sp)
 {
-	sp->completed++;
+	ACCESS_ONCE(sp->completed) = sp->completed + 1;
+	smp_mb(); /* Pairs with B and C. */
 }
 
 /*
- * Enqueue an SRCU callback on the specified srcu_struct structure,
- * initiating grace-period processing if it is not already running.
+ * Return the delay before the next attempt to advance the grace period:
+ * none if an expedited grace period is needed, else SRCU_INTERVAL.
  */
-void call_srcu(struct srcu_struct *sp, struct rcu_head *head,
-		void (*func)(struct rcu_head *head))
+static unsigned long srcu_get_delay(struct srcu_struct *sp)
+{
+	if (ULONG_CMP_LT(ACCESS_ONCE(sp->srcu_gp_seq),
+			 ACCESS_ONCE(sp->srcu_gp_seq_needed_exp)))
+		return 0;
+	return SRCU_INTERVAL;
+}
+
+/*
+ * Start an SRCU grace period.  Must be called with ->lock held and no
+ * grace period in progress.
+ */
+static void srcu_gp_start(struct srcu_struct *sp)
+{
+	srcu_seq_start(&sp->srcu_gp_seq);
+}
+
+/* Schedule callback invocation for the specified srcu_data structure. */
+static void srcu_schedule_cbs_sdp(struct srcu_data *sdp, unsigned long delay)
+{
+	schedule_delayed_work_on(sdp->cpu, &sdp->work, delay);
+}
+
+/*
+ * Schedule callback invocation for the CPUs of the specified leaf
+ * srcu_node that have callbacks waiting for the grace period that just
+ * ended, as given by mask.
+ */
+static void srcu_schedule_cbs_snp(struct srcu_struct *sp,
+				  struct srcu_node *snp,
+				  unsigned long mask, unsigned long delay)
+{
+	int bit;
+
+	for_each_set_bit(bit, &mask, SRCU_FANOUT_LEAF)
+		srcu_schedule_cbs_sdp(per_cpu_ptr(sp->sda, snp->grplo + bit),
+				      delay);
+}
+
+/*
+ * Note the end of an SRCU grace period, then initiate invocation of
+ * the callbacks that were waiting for it and start a new grace period
+ * if one is needed.  Called with ->srcu_gp_mutex held, releases it.
+ */
+static void srcu_gp_end(struct srcu_struct *sp)
+{
+	bool cbs;
+	unsigned long cbdelay;
+	unsigned long gpseq;
+	int i;
+	int idx;
+	unsigned long mask;
+	struct srcu_node *snp;
+
+	/* Prevent more than one additional grace period. */
+	mutex_lock(&sp->srcu_cb_mutex);
+
+	/* End the current grace period. */
+	spin_lock_irq(&sp->lock);
+	WARN_ON_ONCE(srcu_seq_state(sp->srcu_gp_seq) != SRCU_STATE_SCAN2);
+	cbdelay = srcu_get_delay(sp);
+	sp->srcu_last_gp_end = (unsigned long)ktime_to_ns(ktime_get());
+	srcu_seq_end(&sp->srcu_gp_seq);
+	gpseq = srcu_seq_current(&sp->srcu_gp_seq);
+	if (ULONG_CMP_LT(sp->srcu_gp_seq_needed_exp, gpseq))
+		sp->srcu_gp_seq_needed_exp = gpseq;
+	spin_unlock_irq(&sp->lock);
+	mutex_unlock(&sp->srcu_gp_mutex);
+	/* A new grace period can start at this point.  But only one. */
+
+	/* Initiate callback invocation as needed. */
+	idx = srcu_seq_ctr(gpseq) % ARRAY_SIZE(snp->srcu_have_cbs);
+	for (i = 0; i < sp->srcu_num_nodes; i++) {
+		snp = &sp->node[i];
+		spin_lock_irq(&snp->lock);
+		cbs = snp->srcu_have_cbs[idx] == gpseq;
+		/* Late requesters see the grace period as done. */
+		snp->srcu_have_cbs[idx] = gpseq;
+		srcu_seq_set_state(&snp->srcu_have_cbs[idx], 1);
+		if (ULONG_CMP_LT(snp->srcu_gp_seq_needed_exp, gpseq))
+			snp->srcu_gp_seq_needed_exp = gpseq;
+		mask = snp->srcu_data_have_cbs[idx];
+		snp->srcu_data_have_cbs[idx] = 0;
+		spin_unlock_irq(&snp->lock);
+		if (cbs)
+			srcu_schedule_cbs_snp(sp, snp, mask, cbdelay);
+	}
+
+	/* Callback initiation done, allow grace periods after next. */
+	mutex_unlock(&sp->srcu_cb_mutex);
+
+	/* Start a new grace period if needed. */
+	spin_lock_irq(&sp->lock);
+	gpseq = srcu_seq_current(&sp->srcu_gp_seq);
+	if (!srcu_seq_state(gpseq) &&
+	    ULONG_CMP_LT(gpseq, sp->srcu_gp_seq_needed))
+		srcu_gp_start(sp);
+	spin_unlock_irq(&sp->lock);
+}
+
+/*
+ * Funnel-locking scheme to scalably mediate many concurrent expedited
+ * grace-period requests.  Only the first request for a given grace
+ * period goes past its leaf srcu_node.
+ */
+static void srcu_funnel_exp_start(struct srcu_struct *sp,
+				  struct srcu_node *snp, unsigned long s)
 {
 	unsigned long flags;
 
+	if (srcu_seq_done(&sp->srcu_gp_seq, s) ||
+	    ULONG_CMP_GE(ACCESS_ONCE(snp->srcu_gp_seq_needed_exp), s))
+		return;
+	spin_lock_irqsave(&snp->lock, flags);
+	if (ULONG_CMP_GE(snp->srcu_gp_seq_needed_exp, s)) {
+		spin_unlock_irqrestore(&snp->lock, flags);
+		return;
+	}
+	snp->srcu_gp_seq_needed_exp = s;
+	spin_unlock_irqrestore(&snp->lock, flags);
+
+	spin_lock_irqsave(&sp->lock, flags);
+	if (ULONG_CMP_LT(sp->srcu_gp_seq_needed_exp, s))
+		sp->srcu_gp_seq_needed_exp = s;
+	spin_unlock_irqrestore(&sp->lock, flags);
+}
+
+/*
+ * Funnel-locking scheme to scalably mediate many concurrent grace-period
+ * requests.  The leaf srcu_node records that the CPU of the specified
+ * srcu_data structure has callbacks waiting for grace period s, only the
+ * first CPU of that leaf to need s goes on to the srcu_struct to make
+ * sure that the grace period gets started.
+ */
+static void srcu_funnel_gp_start(struct srcu_struct *sp,
+				 struct srcu_data *sdp,
+				 unsigned long s, bool do_norm)
+{
+	unsigned long flags;
+	int idx = srcu_seq_ctr(s) % ARRAY_SIZE(sdp->mynode->srcu_have_cbs);
+	struct srcu_node *snp = sdp->mynode;
+	unsigned long snp_seq;
+
+	spin_lock_irqsave(&snp->lock, flags);
+	if (ULONG_CMP_GE(snp->srcu_have_cbs[idx], s)) {
+		snp_seq = snp->srcu_have_cbs[idx];
+		if (snp_seq == s)
+			snp->srcu_data_have_cbs[idx] |= sdp->grpmask;
+		spin_unlock_irqrestore(&snp->lock, flags);
+		if (snp_seq != s) {
+			/* Grace period already over, invoke our callbacks. */
+			smp_mb(); /* Order callback invocation after GP. */
+			srcu_schedule_cbs_sdp(sdp, do_norm ? SRCU_INTERVAL : 0);
+		} else if (!do_norm) {
+			srcu_funnel_exp_start(sp, snp, s);
+		}
+		return;
+	}
+	snp->srcu_have_cbs[idx] = s;
+	snp->srcu_data_have_cbs[idx] = sdp->grpmask;
+	if (!do_norm && ULONG_CMP_LT(snp->srcu_gp_seq_needed_exp, s))
+		snp->srcu_gp_seq_needed_exp = s;
+	spin_unlock_irqrestore(&snp->lock, flags);
+
+	/* Top of tree, must ensure the grace period will be started. */
+	spin_lock_irqsave(&sp->lock, flags);
+	if (ULONG_CMP_LT(sp->srcu_gp_seq_needed, s))
+		sp->srcu_gp_seq_needed = s;
+	if (!do_norm && ULONG_CMP_LT(sp->srcu_gp_seq_needed_exp, s))
+		sp->srcu_gp_seq_needed_exp = s;
+
+	/* If grace period not already done and none in progress, start it. */
+	if (!srcu_seq_done(&sp->srcu_gp_seq, s) &&
+	    srcu_seq_state(sp->srcu_gp_seq) == SRCU_STATE_IDLE) {
+		srcu_gp_start(sp);
+		schedule_delayed_work(&sp->work, srcu_get_delay(sp));
+	}
+	spin_unlock_irqrestore(&sp->lock, flags);
+}
+
+/*
+ * Enqueue an SRCU callback on the srcu_data structure associated with
+ * the current CPU and the specified srcu_struct structure, initiating
+ * grace-period processing if it is not already running.  Callers on
+ * the same CPU needing the same grace period only take the per-CPU
+ * lock, callers from different CPUs of a leaf only meet at the leaf.
+ */
+static void __call_srcu(struct srcu_struct *sp, struct rcu_head *head,
+			void (*func)(struct rcu_head *head), bool do_norm)
+{
+	unsigned long flags;
+	bool needexp = false;
+	bool needgp = false;
+	unsigned long s;
+	struct srcu_data *sdp;
+
+	check_init_srcu_struct(sp);
 	head->next = NULL;
 	head->func = func;
-	spin_lock_irqsave(&sp->queue_lock, flags);
-	rcu_batch_queue(&sp->batch_queue, head);
-	if (!sp->running) {
-		sp->running = true;
-		schedule_delayed_work(&sp->work, 0);
+	local_irq_save(flags);
+	sdp = this_cpu_ptr(sp->sda);
+	spin_lock(&sdp->lock);
+	srcu_cblist_advance(sdp, srcu_seq_current(&sp->srcu_gp_seq));
+	s = srcu_seq_snap(&sp->srcu_gp_seq);
+	srcu_cblist_enqueue(sdp, head, s);
+	if (ULONG_CMP_LT(sdp->srcu_gp_seq_needed, s)) {
+		sdp->srcu_gp_seq_needed = s;
+		needgp = true;
+	}
+	if (!do_norm && ULONG_CMP_LT(sdp->srcu_gp_seq_needed_exp, s)) {
+		sdp->srcu_gp_seq_needed_exp = s;
+		needexp = true;
 	}
-	spin_unlock_irqrestore(&sp->queue_lock, flags);
+	spin_unlock_irqrestore(&sdp->lock, flags);
+	if (needgp)
+		srcu_funnel_gp_start(sp, sdp, s, do_norm);
+	else if (needexp)
+		srcu_funnel_exp_start(sp, sdp->mynode, s);
+}
+
+void call_srcu(struct srcu_struct *sp, struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	__call_srcu(sp, head, func, true);
 }
 EXPORT_SYMBOL_GPL(call_srcu);
 
@@ -398,17 +839,12 @@ static void wakeme_after_rcu(struct rcu_head *head)
 	complete(&rcu->completion);
 }
 
-static void srcu_advance_batches(struct srcu_struct *sp, int trycount);
-static void srcu_reschedule(struct srcu_struct *sp);
-
 /*
  * Helper function for synchronize_srcu() and synchronize_srcu_expedited().
  */
-static void __synchronize_srcu(struct srcu_struct *sp, int trycount)
+static void __synchronize_srcu(struct srcu_struct *sp, bool do_norm)
 {
 	struct rcu_synchronize rcu;
-	struct rcu_head *head = &rcu.head;
-	bool done = false;
 
 	rcu_lockdep_assert(!lock_is_held(&sp->dep_map) &&
 			   !lock_is_held(&rcu_bh_lock_map) &&
@@ -417,32 +853,81 @@ static void __synchronize_srcu(struct srcu_struct *sp, int trycount)
 			   "Illegal synchronize_srcu() in same-type SRCU (or RCU) read-side critical section");
 
 	might_sleep();
+	if (!rcu_scheduler_active)
+		return; /* Single task, no readers to wait for. */
+
 	init_completion(&rcu.completion);
+	__call_srcu(sp, &rcu.head, wakeme_after_rcu, do_norm);
+	wait_for_completion(&rcu.completion);
 
-	head->next = NULL;
-	head->func = wakeme_after_rcu;
-	spin_lock_irq(&sp->queue_lock);
-	if (!sp->running) {
-		/* steal the processing owner */
-		sp->running = true;
-		rcu_batch_queue(&sp->batch_check0, head);
-		spin_unlock_irq(&sp->queue_lock);
-
-		srcu_advance_batches(sp, trycount);
-		if (!rcu_batch_empty(&sp->batch_done)) {
-			BUG_ON(sp->batch_done.head != head);
-			rcu_batch_dequeue(&sp->batch_done);
-			done = true;
-		}
-		/* give the processing owner to work_struct */
-		srcu_reschedule(sp);
-	} else {
-		rcu_batch_queue(&sp->batch_queue, head);
-		spin_unlock_irq(&sp->queue_lock);
-	}
+	/*
+	 * Make sure that later code is ordered after the SRCU grace
+	 * period, the callback might have run on another CPU.
+	 */
+	smp_mb();
+}
+
+/**
+ * synchronize_srcu_expedited - Brute-force SRCU grace period
+ * @sp: srcu_struct with which to synchronize.
+ *
+ * Wait for an SRCU grace period to elapse, but be more aggressive about
+ * spinning rather than blocking when waiting.
+ *
+ * Note that it is also illegal to call synchronize_srcu_expedited()
+ * from the corresponding SRCU read-side critical section;
+ * doing so will result in deadlock.  However, it is perfectly legal
+ * to call synchronize_srcu_expedited() on one srcu_struct from some
+ * other srcu_struct's read-side critical section, as long as
+ * the resulting graph of srcu_structs is acyclic.
+ */
+void synchronize_srcu_expedited(struct srcu_struct *sp)
+{
+	__synchronize_srcu(sp, false);
+}
+EXPORT_SYMBOL_GPL(synchronize_srcu_expedited);
 
-	if (!done)
-		wait_for_completion(&rcu.completion);
+/*
+ * Return true if the specified srcu_struct is probably idle: no
+ * callbacks on this CPU, no grace period in flight and none ended in
+ * the last exp_holdoff nanoseconds.  Exact information would require
+ * acquiring locks, which would kill scalability.
+ */
+static bool srcu_might_be_idle(struct srcu_struct *sp)
+{
+	unsigned long curseq;
+	unsigned long flags;
+	struct srcu_data *sdp;
+	unsigned long t;
+	bool pending;
+
+	check_init_srcu_struct(sp);
+
+	/* If the local srcu_data structure has callbacks, not idle.  */
+	local_irq_save(flags);
+	sdp = this_cpu_ptr(sp->sda);
+	pending = !rcu_batch_empty(&sdp->batch_wait) ||
+		  !rcu_batch_empty(&sdp->batch_next);
+	local_irq_restore(flags);
+	if (pending)
+		return false; /* Callbacks already present, so not idle. */
+
+	/* First, see if enough time has passed since the last GP. */
+	t = (unsigned long)ktime_to_ns(ktime_get());
+	if (exp_holdoff == 0 ||
+	    time_in_range_open(t, ACCESS_ONCE(sp->srcu_last_gp_end),
+			       ACCESS_ONCE(sp->srcu_last_gp_end) + exp_holdoff))
+		return false; /* Too soon after last GP. */
+
+	/* Next, check for probable idleness. */
+	curseq = srcu_seq_current(&sp->srcu_gp_seq);
+	smp_mb(); /* Order ->srcu_gp_seq with ->srcu_gp_seq_needed. */
+	if (ULONG_CMP_LT(curseq, ACCESS_ONCE(sp->srcu_gp_seq_needed)))
+		return false; /* Grace period in progress, so not idle. */
+	smp_mb(); /* Order ->srcu_gp_seq with prior access. */
+	if (curseq != srcu_seq_current(&sp->srcu_gp_seq))
+		return false; /* GP # changed, so not idle. */
+	return true; /* With reasonable probability, idle! */
 }
 
 /**
@@ -454,6 +939,10 @@ static void __synchronize_srcu(struct srcu_struct *sp, int trycount)
  * the index=((->completed & 1) ^ 1) to drain to zero at first,
  * and then flip the completed and wait for the count of the other index.
  *
+ * If the srcu_struct looks idle, the grace period is expedited: an
+ * isolated synchronize_srcu() then costs a few microseconds rather than
+ * a few jiffies.
+ *
  * Can block; must be called from process context.
  *
  * Note that it is illegal to call synchronize_srcu() from the corresponding
@@ -463,38 +952,65 @@ static void __synchronize_srcu(struct srcu_struct *sp, int trycount)
  */
 void synchronize_srcu(struct srcu_struct *sp)
 {
-	__synchronize_srcu(sp, rcu_expedited
-			   ? SYNCHRONIZE_SRCU_EXP_TRYCOUNT
-			   : SYNCHRONIZE_SRCU_TRYCOUNT);
+	if (srcu_might_be_idle(sp) || rcu_expedited)
+		synchronize_srcu_expedited(sp);
+	else
+		__synchronize_srcu(sp, true);
 }
 EXPORT_SYMBOL_GPL(synchronize_srcu);
 
-/**
- * synchronize_srcu_expedited - Brute-force SRCU grace period
- * @sp: srcu_struct with which to synchronize.
- *
- * Wait for an SRCU grace period to elapse, but be more aggressive about
- * spinning rather than blocking when waiting.
- *
- * Note that it is also illegal to call synchronize_srcu_expedited()
- * from the corresponding SRCU read-side critical section;
- * doing so will result in deadlock.  However, it is perfectly legal
- * to call synchronize_srcu_expedited() on one srcu_struct from some
- * other srcu_struct's read-side critical section, as long as
- * the resulting graph of srcu_structs is acyclic.
+/*
+ * Callback function for srcu_barrier() use.
  */
-void synchronize_srcu_expedited(struct srcu_struct *sp)
+static void srcu_barrier_cb(struct rcu_head *rhp)
 {
-	__synchronize_srcu(sp, SYNCHRONIZE_SRCU_EXP_TRYCOUNT);
+	struct srcu_data *sdp;
+	struct srcu_struct *sp;
+
+	sdp = container_of(rhp, struct srcu_data, srcu_barrier_head);
+	sp = sdp->sp;
+	if (atomic_dec_and_test(&sp->srcu_barrier_cpu_cnt))
+		complete(&sp->srcu_barrier_completion);
 }
-EXPORT_SYMBOL_GPL(synchronize_srcu_expedited);
 
 /**
  * srcu_barrier - Wait until all in-flight call_srcu() callbacks complete.
+ * @sp: srcu_struct on which to wait for in-flight callbacks.
  */
 void srcu_barrier(struct srcu_struct *sp)
 {
-	synchronize_srcu(sp);
+	int cpu;
+	struct srcu_data *sdp;
+
+	check_init_srcu_struct(sp);
+	mutex_lock(&sp->srcu_barrier_mutex);
+	init_completion(&sp->srcu_barrier_completion);
+
+	/* Initial count prevents reaching zero until all CBs are posted. */
+	atomic_set(&sp->srcu_barrier_cpu_cnt, 1);
+
+	/*
+	 * Each pass through this loop enqueues a callback behind the
+	 * existing ones of a CPU, it is then invoked after all of them.
+	 * CPUs without callbacks have nothing to wait for.
+	 */
+	for_each_possible_cpu(cpu) {
+		sdp = per_cpu_ptr(sp->sda, cpu);
+		spin_lock_irq(&sdp->lock);
+		atomic_inc(&sp->srcu_barrier_cpu_cnt);
+		sdp->srcu_barrier_head.next = NULL;
+		sdp->srcu_barrier_head.func = srcu_barrier_cb;
+		if (!srcu_cblist_entrain(sdp, &sdp->srcu_barrier_head))
+			atomic_dec(&sp->srcu_barrier_cpu_cnt);
+		spin_unlock_irq(&sdp->lock);
+	}
+
+	/* Remove the initial count, at which point reaching zero can happen. */
+	if (atomic_dec_and_test(&sp->srcu_barrier_cpu_cnt))
+		complete(&sp->srcu_barrier_completion);
+	wait_for_completion(&sp->srcu_barrier_completion);
+
+	mutex_unlock(&sp->srcu_barrier_mutex);
 }
 EXPORT_SYMBOL_GPL(srcu_barrier);
 
@@ -511,29 +1027,17 @@ long srcu_batches_completed(struct srcu_struct *sp)
 }
 EXPORT_SYMBOL_GPL(srcu_batches_completed);
 
-#define SRCU_CALLBACK_BATCH	10
-#define SRCU_INTERVAL		1
-
 /*
- * Move any new SRCU callbacks to the first stage of the SRCU grace
- * period pipeline.
+ * Core SRCU state machine.  Push state bits of ->srcu_gp_seq
+ * to SRCU_STATE_SCAN2, and invoke srcu_gp_end() when scan has
+ * completed in that state.
  */
-static void srcu_collect_new(struct srcu_struct *sp)
+static void srcu_advance_state(struct srcu_struct *sp)
 {
-	if (!rcu_batch_empty(&sp->batch_queue)) {
-		spin_lock_irq(&sp->queue_lock);
-		rcu_batch_move(&sp->batch_check0, &sp->batch_queue);
-		spin_unlock_irq(&sp->queue_lock);
-	}
-}
+	int idx;
+	int trycount;
 
-/*
- * Core SRCU state machine.  Advance callbacks from ->batch_check0 to
- * ->batch_check1 and then to ->batch_done as readers drain.
- */
-static void srcu_advance_batches(struct srcu_struct *sp, int trycount)
-{
-	int idx = 1 ^ (sp->completed & 1);
+	mutex_lock(&sp->srcu_gp_mutex);
 
 	/*
 	 * Because readers might be delayed for an extended period after
@@ -541,97 +1045,123 @@ static void srcu_advance_batches(struct srcu_struct *sp, int trycount)
 	 * might well be readers using both idx=0 and idx=1.  We therefore
 	 * need to wait for readers to clear from both index values before
 	 * invoking a callback.
+	 *
+	 * The barrier in srcu_seq_current() ensures that we see the
+	 * accesses performed by the prior grace period.
 	 */
+	idx = srcu_seq_state(srcu_seq_current(&sp->srcu_gp_seq));
+	if (idx == SRCU_STATE_IDLE) {
+		spin_lock_irq(&sp->lock);
+		if (ULONG_CMP_GE(sp->srcu_gp_seq, sp->srcu_gp_seq_needed)) {
+			WARN_ON_ONCE(srcu_seq_state(sp->srcu_gp_seq));
+			spin_unlock_irq(&sp->lock);
+			mutex_unlock(&sp->srcu_gp_mutex);
+			return;
+		}
+		idx = srcu_seq_state(ACCESS_ONCE(sp->srcu_gp_seq));
+		if (idx == SRCU_STATE_IDLE)
+			srcu_gp_start(sp);
+		spin_unlock_irq(&sp->lock);
+		if (idx != SRCU_STATE_IDLE) {
+			mutex_unlock(&sp->srcu_gp_mutex);
+			return; /* Someone else started the grace period. */
+		}
+	}
 
-	if (rcu_batch_empty(&sp->batch_check0) &&
-	    rcu_batch_empty(&sp->batch_check1))
-		return; /* no callbacks need to be advanced */
-
-	if (!try_check_zero(sp, idx, trycount))
-		return; /* failed to advance, will try after SRCU_INTERVAL */
-
-	/*
-	 * The callbacks in ->batch_check1 have already done with their
-	 * first zero check and flip back when they were enqueued on
-	 * ->batch_check0 in a previous invocation of srcu_advance_batches().
-	 * (Presumably try_check_zero() returned false during that
-	 * invocation, leaving the callbacks stranded on ->batch_check1.)
-	 * They are therefore ready to invoke, so move them to ->batch_done.
-	 */
-	rcu_batch_move(&sp->batch_done, &sp->batch_check1);
-
-	if (rcu_batch_empty(&sp->batch_check0))
-		return; /* no callbacks need to be advanced */
-	srcu_flip(sp);
-
-	/*
-	 * The callbacks in ->batch_check0 just finished their
-	 * first check zero and flip, so move them to ->batch_check1
-	 * for future checking on the other idx.
-	 */
-	rcu_batch_move(&sp->batch_check1, &sp->batch_check0);
-
-	/*
-	 * SRCU read-side critical sections are normally short, so check
-	 * at least twice in quick succession after a flip.
-	 */
-	trycount = trycount < 2 ? 2 : trycount;
-	if (!try_check_zero(sp, idx^1, trycount))
-		return; /* failed to advance, will try after SRCU_INTERVAL */
+	trycount = srcu_get_delay(sp) ? 1 : SYNCHRONIZE_SRCU_EXP_TRYCOUNT;
+	if (srcu_seq_state(ACCESS_ONCE(sp->srcu_gp_seq)) == SRCU_STATE_SCAN1) {
+		idx = 1 ^ (sp->completed & 1);
+		if (!try_check_zero(sp, idx, trycount)) {
+			mutex_unlock(&sp->srcu_gp_mutex);
+			return; /* readers present, retry later. */
+		}
+		srcu_flip(sp);
+		spin_lock_irq(&sp->lock);
+		srcu_seq_set_state(&sp->srcu_gp_seq, SRCU_STATE_SCAN2);
+		spin_unlock_irq(&sp->lock);
+	}
 
-	/*
-	 * The callbacks in ->batch_check1 have now waited for all
-	 * pre-existing readers using both idx values.  They are therefore
-	 * ready to invoke, so move them to ->batch_done.
-	 */
-	rcu_batch_move(&sp->batch_done, &sp->batch_check1);
+	if (srcu_seq_state(ACCESS_ONCE(sp->srcu_gp_seq)) == SRCU_STATE_SCAN2) {
+		/*
+		 * SRCU read-side critical sections are normally short,
+		 * so check at least twice in quick succession after a flip.
+		 */
+		idx = 1 ^ (sp->completed & 1);
+		if (!try_check_zero(sp, idx, max(trycount,
+						 SYNCHRONIZE_SRCU_TRYCOUNT))) {
+			mutex_unlock(&sp->srcu_gp_mutex);
+			return; /* readers present, retry later. */
+		}
+		srcu_gp_end(sp);  /* Releases ->srcu_gp_mutex. */
+		return;
+	}
+	mutex_unlock(&sp->srcu_gp_mutex);
 }
 
 /*
- * Invoke a limited number of SRCU callbacks that have passed through
- * their grace period.  If there are more to do, SRCU will reschedule
- * the workqueue.
+ * Invoke the SRCU callbacks of the specified CPU that have passed
+ * through their grace period.  Runs on the CPU that queued them.
  */
-static void srcu_invoke_callbacks(struct srcu_struct *sp)
+static void srcu_invoke_callbacks(struct work_struct *work)
 {
-	int i;
+	bool more;
+	struct rcu_batch ready;
 	struct rcu_head *head;
+	struct srcu_data *sdp;
+	struct srcu_struct *sp;
+
+	sdp = container_of(work, struct srcu_data, work.work);
+	sp = sdp->sp;
+	rcu_batch_init(&ready);
+	spin_lock_irq(&sdp->lock);
+	srcu_cblist_advance(sdp, srcu_seq_current(&sp->srcu_gp_seq));
+	if (sdp->srcu_cblist_invoking ||
+	    rcu_batch_empty(&sdp->batch_done)) {
+		spin_unlock_irq(&sdp->lock);
+		return;  /* Someone else on the job or nothing to do. */
+	}
 
-	for (i = 0; i < SRCU_CALLBACK_BATCH; i++) {
-		head = rcu_batch_dequeue(&sp->batch_done);
-		if (!head)
-			break;
+	/* We are on the job!  Extract and invoke ready callbacks. */
+	sdp->srcu_cblist_invoking = true;
+	rcu_batch_move(&ready, &sdp->batch_done);
+	spin_unlock_irq(&sdp->lock);
+	while ((head = rcu_batch_dequeue(&ready)) != NULL) {
 		local_bh_disable();
 		head->func(head);
 		local_bh_enable();
 	}
+
+	/* Callbacks may have become ready in the meantime. */
+	spin_lock_irq(&sdp->lock);
+	sdp->srcu_cblist_invoking = false;
+	more = !rcu_batch_empty(&sdp->batch_done);
+	spin_unlock_irq(&sdp->lock);
+	if (more)
+		srcu_schedule_cbs_sdp(sdp, 0);
 }
 
 /*
  * Finished one round of SRCU grace period.  Start another if there are
  * more SRCU callbacks queued, otherwise put SRCU into not-running state.
  */
-static void srcu_reschedule(struct srcu_struct *sp)
-{
-	bool pending = true;
-
-	if (rcu_batch_empty(&sp->batch_done) &&
-	    rcu_batch_empty(&sp->batch_check1) &&
-	    rcu_batch_empty(&sp->batch_check0) &&
-	    rcu_batch_empty(&sp->batch_queue)) {
-		spin_lock_irq(&sp->queue_lock);
-		if (rcu_batch_empty(&sp->batch_done) &&
-		    rcu_batch_empty(&sp->batch_check1) &&
-		    rcu_batch_empty(&sp->batch_check0) &&
-		    rcu_batch_empty(&sp->batch_queue)) {
-			sp->running = false;
-			pending = false;
+static void srcu_reschedule(struct srcu_struct *sp, unsigned long delay)
+{
+	bool pushgp = true;
+
+	spin_lock_irq(&sp->lock);
+	if (ULONG_CMP_GE(sp->srcu_gp_seq, sp->srcu_gp_seq_needed)) {
+		if (!WARN_ON_ONCE(srcu_seq_state(sp->srcu_gp_seq))) {
+			/* All requests fulfilled, time to go idle. */
+			pushgp = false;
 		}
-		spin_unlock_irq(&sp->queue_lock);
+	} else if (!srcu_seq_state(sp->srcu_gp_seq)) {
+		/* Outstanding request and no GP.  Start one. */
+		srcu_gp_start(sp);
 	}
+	spin_unlock_irq(&sp->lock);
 
-	if (pending)
-		schedule_delayed_work(&sp->work, SRCU_INTERVAL);
+	if (pushgp)
+		schedule_delayed_work(&sp->work, delay);
 }
 
 /*
@@ -643,9 +1173,7 @@ void process_srcu(struct work_struct *work)
 
 	sp = container_of(work, struct srcu_struct, work.work);
 
-	srcu_collect_new(sp);
-	srcu_advance_batches(sp, 1);
-	srcu_invoke_callbacks(sp);
-	srcu_reschedule(sp);
+	srcu_advance_state(sp);
+	srcu_reschedule(sp, srcu_get_delay(sp));
 }
 EXPORT_SYMBOL_GPL(process_srcu);
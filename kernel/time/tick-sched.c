@@ -21,11 +21,15 @@
 #include <linux/sched.h>
 #include <linux/module.h>
 #include <linux/irq_work.h>
+#include <linux/context_tracking.h>
+#include <linux/vmstat.h>
 
 #include <asm/irq_regs.h>
 
 #include "tick-internal.h"
 
+#include <trace/events/timer.h>
+
 /*
  * Per cpu nohz control structure
  */
@@ -110,9 +114,11 @@ static void tick_sched_do_timer(ktime_t now)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * jiffies_lock.
+	 * jiffies_lock. Full dynticks CPUs never take the duty, it stays
+	 * with the housekeeping CPUs.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -142,6 +148,443 @@ static void tick_sched_handle(struct tick_sched *ts, struct pt_regs *regs)
 	profile_tick(CPU_PROFILING);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+cpumask_var_t tick_nohz_full_mask;
+cpumask_var_t housekeeping_mask;
+bool tick_nohz_full_running;
+static atomic_t tick_dep_mask;
+
+static bool check_tick_dependency(atomic_t *dep)
+{
+	int val = atomic_read(dep);
+
+	if (val) {
+		/* Report the lowest dependency bit keeping the tick alive */
+		trace_tick_stop(0, val & -val);
+		return true;
+	}
+
+	return false;
+}
+
+static bool can_stop_full_tick(struct tick_sched *ts)
+{
+	WARN_ON_ONCE(!irqs_disabled());
+
+	if (check_tick_dependency(&tick_dep_mask))
+		return false;
+
+	if (check_tick_dependency(&ts->tick_dep_mask))
+		return false;
+
+	if (check_tick_dependency(&current->tick_dep_mask))
+		return false;
+
+	if (check_tick_dependency(&current->signal->tick_dep_mask))
+		return false;
+
+	/* sched_clock_tick() needs us? */
+#ifdef CONFIG_HAVE_UNSTABLE_SCHED_CLOCK
+	/*
+	 * sched_clock_stable is flipped by arch code without any hook
+	 * we could use to set a dependency, so it's polled instead.
+	 */
+	if (!sched_clock_stable) {
+		trace_tick_stop(0, TICK_DEP_MASK_CLOCK_UNSTABLE);
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+static void nohz_full_kick_func(struct irq_work *work)
+{
+	/* Empty, the tick restart happens on tick_nohz_irq_exit() */
+}
+
+static DEFINE_PER_CPU(struct irq_work, nohz_full_kick_work) = {
+	.func = nohz_full_kick_func,
+};
+
+/*
+ * Kick the current CPU if it's full dynticks in order to force it to
+ * re-evaluate its dependency on the tick and restart it if necessary.
+ * This kick, unlike tick_nohz_full_kick_cpu() and tick_nohz_full_kick_all(),
+ * is NMI safe.
+ */
+void tick_nohz_full_kick(void)
+{
+	if (!tick_nohz_full_cpu(smp_processor_id()))
+		return;
+
+	irq_work_queue(&__get_cpu_var(nohz_full_kick_work));
+}
+
+/*
+ * Kick the CPU if it's full dynticks in order to force it to
+ * re-evaluate its dependency on the tick and restart it if necessary.
+ * The local CPU is only kicked if its tick is stopped, a running tick
+ * re-evaluates the dependencies on its own.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	preempt_disable();
+	if (cpu == smp_processor_id()) {
+		if (tick_nohz_tick_stopped())
+			tick_nohz_full_kick();
+	} else {
+		irq_work_queue_on(&per_cpu(nohz_full_kick_work, cpu), cpu);
+	}
+	preempt_enable();
+}
+
+/*
+ * Kick all full dynticks CPUs in order to force these to re-evaluate
+ * their dependency on the tick and restart it if necessary.
+ */
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		tick_nohz_full_kick_cpu(cpu);
+	preempt_enable();
+}
+
+/* Atomically OR @mask into @dep and return the previous value. */
+static int tick_dep_fetch_or(atomic_t *dep, int mask)
+{
+	int old, val = atomic_read(dep);
+
+	for (;;) {
+		old = atomic_cmpxchg(dep, val, val | mask);
+		if (old == val)
+			break;
+		val = old;
+	}
+
+	return old;
+}
+
+static void tick_dep_andnot(atomic_t *dep, int mask)
+{
+	int old, val = atomic_read(dep);
+
+	for (;;) {
+		old = atomic_cmpxchg(dep, val, val & ~mask);
+		if (old == val)
+			break;
+		val = old;
+	}
+}
+
+static void tick_nohz_dep_set_all(atomic_t *dep,
+				  enum tick_dep_bits bit)
+{
+	int prev;
+
+	prev = tick_dep_fetch_or(dep, 1 << bit);
+	if (!prev)
+		tick_nohz_full_kick_all();
+}
+
+/*
+ * Set a global tick dependency. Used by perf events that rely on freq and
+ * by unstable clock.
+ */
+void tick_nohz_dep_set(enum tick_dep_bits bit)
+{
+	tick_nohz_dep_set_all(&tick_dep_mask, bit);
+}
+
+void tick_nohz_dep_clear(enum tick_dep_bits bit)
+{
+	tick_dep_andnot(&tick_dep_mask, 1 << bit);
+}
+
+/*
+ * Set per-CPU tick dependency. Used by scheduler and perf events in order to
+ * manage events throttling.
+ */
+void tick_nohz_dep_set_cpu(int cpu, enum tick_dep_bits bit)
+{
+	int prev;
+	struct tick_sched *ts;
+
+	ts = per_cpu_ptr(&tick_cpu_sched, cpu);
+
+	prev = tick_dep_fetch_or(&ts->tick_dep_mask, 1 << bit);
+	if (!prev)
+		tick_nohz_full_kick_cpu(cpu);
+}
+
+void tick_nohz_dep_clear_cpu(int cpu, enum tick_dep_bits bit)
+{
+	struct tick_sched *ts = per_cpu_ptr(&tick_cpu_sched, cpu);
+
+	tick_dep_andnot(&ts->tick_dep_mask, 1 << bit);
+}
+
+/*
+ * Set a per-task tick dependency. The CPU the task runs on is kicked, a
+ * later migration is handled by the context switch re-evaluation.
+ */
+void tick_nohz_dep_set_task(struct task_struct *tsk, enum tick_dep_bits bit)
+{
+	int prev;
+
+	prev = tick_dep_fetch_or(&tsk->tick_dep_mask, 1 << bit);
+	if (!prev)
+		tick_nohz_full_kick_cpu(task_cpu(tsk));
+}
+
+void tick_nohz_dep_clear_task(struct task_struct *tsk, enum tick_dep_bits bit)
+{
+	tick_dep_andnot(&tsk->tick_dep_mask, 1 << bit);
+}
+
+/*
+ * Set a per-taskgroup tick dependency. The threads may run on any full
+ * dynticks CPU, so all of them are kicked.
+ */
+void tick_nohz_dep_set_signal(struct signal_struct *sig, enum tick_dep_bits bit)
+{
+	tick_nohz_dep_set_all(&sig->tick_dep_mask, bit);
+}
+
+void tick_nohz_dep_clear_signal(struct signal_struct *sig, enum tick_dep_bits bit)
+{
+	tick_dep_andnot(&sig->tick_dep_mask, 1 << bit);
+}
+
+/*
+ * Re-evaluate the need for the tick as we switch the current task.
+ * It might need the tick due to per task/process properties:
+ * perf events, posix cpu timers, ...
+ */
+void __tick_nohz_task_switch(struct task_struct *tsk)
+{
+	unsigned long flags;
+	struct tick_sched *ts;
+
+	local_irq_save(flags);
+
+	if (!tick_nohz_full_cpu(smp_processor_id()))
+		goto out;
+
+	ts = &__get_cpu_var(tick_cpu_sched);
+
+	if (ts->tick_stopped) {
+		if (atomic_read(&current->tick_dep_mask) ||
+		    atomic_read(&current->signal->tick_dep_mask))
+			tick_nohz_full_kick();
+	}
+out:
+	local_irq_restore(flags);
+}
+
+/*
+ * Number of full dynticks CPUs running a task with their tick stopped.
+ * As long as it is non-zero, the CPU in charge of the timekeeping duty
+ * keeps its tick so that jiffies and walltime make progress without
+ * any help from the full dynticks CPUs.
+ */
+static atomic_t tick_nohz_full_busy;
+
+/* Last CPU which dropped the timekeeping duty to enter dynticks idle */
+static int tick_do_timer_last_cpu;
+
+static bool tick_nohz_full_keep_tick(int cpu)
+{
+	if (!atomic_read(&tick_nohz_full_busy))
+		return false;
+
+	/*
+	 * Keep the tick on the timekeeper and, if the duty is orphaned,
+	 * on every housekeeping CPU until one of them takes it.
+	 */
+	return tick_do_timer_cpu == cpu ||
+	       (tick_do_timer_cpu == TICK_DO_TIMER_NONE &&
+		!tick_nohz_full_cpu(cpu));
+}
+
+static void tick_nohz_full_busy_enter(struct tick_sched *ts)
+{
+	int cpu;
+
+	if (ts->full_busy)
+		return;
+
+	ts->full_busy = 1;
+	if (atomic_inc_return(&tick_nohz_full_busy) != 1)
+		return;
+
+	/*
+	 * We are the first full dynticks CPU to run tickless. The
+	 * timekeeper may be sleeping in dynticks idle: pull it out of
+	 * the idle loop so that it re-evaluates its tick against the
+	 * new busy count.
+	 */
+	cpu = ACCESS_ONCE(tick_do_timer_cpu);
+	if (cpu == TICK_DO_TIMER_NONE)
+		cpu = ACCESS_ONCE(tick_do_timer_last_cpu);
+	if (cpu >= 0 && cpu_online(cpu))
+		wake_up_idle_cpu(cpu);
+}
+
+static void tick_nohz_full_busy_exit(struct tick_sched *ts)
+{
+	if (!ts->full_busy)
+		return;
+
+	ts->full_busy = 0;
+	atomic_dec(&tick_nohz_full_busy);
+}
+
+/*
+ * Hand the timekeeping duty over to another online housekeeping CPU
+ * before its owner goes down. Refuse to offline the last housekeeping
+ * CPU, full dynticks CPUs must never take the duty.
+ */
+static int __cpuinit tick_nohz_cpu_down_callback(struct notifier_block *nfb,
+						 unsigned long action,
+						 void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+	int new;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_DOWN_PREPARE:
+		if (tick_nohz_full_cpu(cpu))
+			break;
+
+		/*
+		 * Look for another housekeeping CPU whoever owns the duty: an
+		 * idle timekeeper drops it to TICK_DO_TIMER_NONE, and full
+		 * dynticks CPUs never take it back.
+		 */
+		for_each_online_cpu(new) {
+			if (new != cpu && !tick_nohz_full_cpu(new))
+				break;
+		}
+		if (new >= nr_cpu_ids) {
+			pr_warn("NO_HZ: Can't offline the last timekeeping CPU %d\n",
+				cpu);
+			return NOTIFY_BAD;
+		}
+
+		if (tick_do_timer_cpu == cpu) {
+			tick_do_timer_cpu = new;
+			wake_up_idle_cpu(new);
+		}
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+/* Parse the boot-time nohz CPU list from the kernel parameters. */
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu;
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		pr_warn("NO_HZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	cpu = smp_processor_id();
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		pr_warn("NO_HZ: Clearing %d from nohz_full range for timekeeping\n",
+			cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = true;
+
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+#ifdef CONFIG_NO_HZ_FULL_ALL
+static int tick_nohz_init_all(void)
+{
+	int err = -1;
+
+	if (!alloc_cpumask_var(&tick_nohz_full_mask, GFP_KERNEL)) {
+		pr_err("NO_HZ: Can't allocate full dynticks cpumask\n");
+		return err;
+	}
+	err = 0;
+	cpumask_setall(tick_nohz_full_mask);
+	cpumask_clear_cpu(smp_processor_id(), tick_nohz_full_mask);
+	tick_nohz_full_running = true;
+
+	return err;
+}
+#else
+static int tick_nohz_init_all(void)
+{
+	return -ENODEV;
+}
+#endif /* CONFIG_NO_HZ_FULL_ALL */
+
+static char __initdata nohz_full_buf[NR_CPUS * 5];
+
+void __init tick_nohz_init(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running) {
+		if (tick_nohz_init_all() < 0)
+			return;
+	}
+
+	if (!alloc_cpumask_var(&housekeeping_mask, GFP_KERNEL)) {
+		pr_err("NO_HZ: Can't allocate housekeeping cpumask\n");
+		tick_nohz_full_running = false;
+		return;
+	}
+	cpumask_andnot(housekeeping_mask, cpu_possible_mask,
+		       tick_nohz_full_mask);
+
+	/*
+	 * Full dynticks CPUs rely on the context tracking to account
+	 * the cputime and to put RCU in extended quiescent state while
+	 * running in userspace.
+	 */
+	for_each_cpu(cpu, tick_nohz_full_mask)
+		context_tracking_cpu_set(cpu);
+
+	cpu_notifier(tick_nohz_cpu_down_callback, 0);
+
+	cpulist_scnprintf(nohz_full_buf, sizeof(nohz_full_buf),
+			  tick_nohz_full_mask);
+	pr_info("NO_HZ: Full dynticks CPUs: %s.\n", nohz_full_buf);
+}
+
+/*
+ * Keep a kthread doing system wide work off the full dynticks CPUs.
+ * Its affinity can still be changed from userspace afterward.
+ */
+void housekeeping_affine(struct task_struct *t)
+{
+	if (tick_nohz_full_enabled())
+		set_cpus_allowed_ptr(t, housekeeping_mask);
+}
+#else
+static inline bool tick_nohz_full_keep_tick(int cpu) { return false; }
+static inline void tick_nohz_full_busy_enter(struct tick_sched *ts) { }
+static inline void tick_nohz_full_busy_exit(struct tick_sched *ts) { }
+#endif /* CONFIG_NO_HZ_FULL */
+
 /*
  * NOHZ - aka dynamic tick functionality
  */
@@ -193,33 +636,26 @@ static void tick_nohz_update_jiffies(ktime_t now)
 }
 
 /*
- * Updates the per cpu time idle statistics counters
+ * The idle statistics are only ever written by their own CPU, under
+ * idle_sleeptime_seq. Remote readers take lockless snapshots and never
+ * write to them, so that polling them doesn't bounce the cache lines of
+ * the idle CPUs.
  */
-static void
-update_ts_time_stats(int cpu, struct tick_sched *ts, ktime_t now, u64 *last_update_time)
-{
-	ktime_t delta;
-
-	if (ts->idle_active) {
-		delta = ktime_sub(now, ts->idle_entrytime);
-		if (nr_iowait_cpu(cpu) > 0)
-			ts->iowait_sleeptime = ktime_add(ts->iowait_sleeptime, delta);
-		else
-			ts->idle_sleeptime = ktime_add(ts->idle_sleeptime, delta);
-		ts->idle_entrytime = now;
-	}
-
-	if (last_update_time)
-		*last_update_time = ktime_to_us(now);
-
-}
-
 static void tick_nohz_stop_idle(int cpu, ktime_t now)
 {
 	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+	ktime_t delta;
 
-	update_ts_time_stats(cpu, ts, now, NULL);
+	delta = ktime_sub(now, ts->idle_entrytime);
+
+	write_seqcount_begin(&ts->idle_sleeptime_seq);
+	if (nr_iowait_cpu(cpu) > 0)
+		ts->iowait_sleeptime = ktime_add(ts->iowait_sleeptime, delta);
+	else
+		ts->idle_sleeptime = ktime_add(ts->idle_sleeptime, delta);
+	ts->idle_entrytime = now;
 	ts->idle_active = 0;
+	write_seqcount_end(&ts->idle_sleeptime_seq);
 
 	sched_clock_idle_wakeup_event(0);
 }
@@ -228,58 +664,95 @@ static ktime_t tick_nohz_start_idle(int cpu, struct tick_sched *ts)
 {
 	ktime_t now = ktime_get();
 
+	write_seqcount_begin(&ts->idle_sleeptime_seq);
 	ts->idle_entrytime = now;
 	ts->idle_active = 1;
+	write_seqcount_end(&ts->idle_sleeptime_seq);
+
 	sched_clock_idle_sleep_event();
 	return now;
 }
 
 /**
- * get_cpu_idle_time_us - get the total idle time of a cpu
+ * get_cpu_sleep_time_us - get the total idle and iowait times of a cpu
  * @cpu: CPU number to query
- * @last_update_time: variable to store update time in. Do not update
- * counters if NULL.
+ * @idle: variable to store the idle time in, can be NULL
+ * @iowait: variable to store the iowait time in, can be NULL
+ * @last_update_time: variable to store the snapshot time in, can be NULL
  *
- * Return the cummulative idle time (since boot) for a given
- * CPU, in microseconds.
+ * Take a consistent snapshot of the cummulative idle and iowait times
+ * (since boot) of a given CPU, in microseconds. The time slept so far
+ * in the current idle period is accounted to iowait if the CPU has IO
+ * outstanding.
  *
- * This time is measured via accounting rather than sampling,
- * and is as accurate as ktime_get() is.
+ * This is lockless and doesn't write to the statistics of @cpu.
  *
- * This function returns -1 if NOHZ is not enabled.
+ * This function returns -1 if NOHZ is not enabled, 0 otherwise.
  */
-u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time)
+int get_cpu_sleep_time_us(int cpu, u64 *idle, u64 *iowait,
+			  u64 *last_update_time)
 {
 	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
-	ktime_t now, idle;
+	ktime_t now, idle_time, iowait_time, delta;
+	unsigned int seq;
 
 	if (!tick_nohz_enabled)
 		return -1;
 
 	now = ktime_get();
-	if (last_update_time) {
-		update_ts_time_stats(cpu, ts, now, last_update_time);
-		idle = ts->idle_sleeptime;
-	} else {
-		if (ts->idle_active && !nr_iowait_cpu(cpu)) {
-			ktime_t delta = ktime_sub(now, ts->idle_entrytime);
+	if (last_update_time)
+		*last_update_time = ktime_to_us(now);
 
-			idle = ktime_add(ts->idle_sleeptime, delta);
-		} else {
-			idle = ts->idle_sleeptime;
+	do {
+		seq = read_seqcount_begin(&ts->idle_sleeptime_seq);
+		idle_time = ts->idle_sleeptime;
+		iowait_time = ts->iowait_sleeptime;
+		if (ts->idle_active) {
+			delta = ktime_sub(now, ts->idle_entrytime);
+			if (nr_iowait_cpu(cpu) > 0)
+				iowait_time = ktime_add(iowait_time, delta);
+			else
+				idle_time = ktime_add(idle_time, delta);
 		}
-	}
+	} while (read_seqcount_retry(&ts->idle_sleeptime_seq, seq));
+
+	if (idle)
+		*idle = ktime_to_us(idle_time);
+	if (iowait)
+		*iowait = ktime_to_us(iowait_time);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(get_cpu_sleep_time_us);
+
+/**
+ * get_cpu_idle_time_us - get the total idle time of a cpu
+ * @cpu: CPU number to query
+ * @last_update_time: variable to store update time in, can be NULL
+ *
+ * Return the cummulative idle time (since boot) for a given
+ * CPU, in microseconds.
+ *
+ * This time is measured via accounting rather than sampling,
+ * and is as accurate as ktime_get() is.
+ *
+ * This function returns -1 if NOHZ is not enabled.
+ */
+u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time)
+{
+	u64 idle;
 
-	return ktime_to_us(idle);
+	if (get_cpu_sleep_time_us(cpu, &idle, NULL, last_update_time))
+		return -1;
 
+	return idle;
 }
 EXPORT_SYMBOL_GPL(get_cpu_idle_time_us);
 
 /**
  * get_cpu_iowait_time_us - get the total iowait time of a cpu
  * @cpu: CPU number to query
- * @last_update_time: variable to store update time in. Do not update
- * counters if NULL.
+ * @last_update_time: variable to store update time in, can be NULL
  *
  * Return the cummulative iowait time (since boot) for a given
  * CPU, in microseconds.
@@ -291,27 +764,12 @@ EXPORT_SYMBOL_GPL(get_cpu_idle_time_us);
  */
 u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time)
 {
-	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
-	ktime_t now, iowait;
+	u64 iowait;
 
-	if (!tick_nohz_enabled)
+	if (get_cpu_sleep_time_us(cpu, NULL, &iowait, last_update_time))
 		return -1;
 
-	now = ktime_get();
-	if (last_update_time) {
-		update_ts_time_stats(cpu, ts, now, last_update_time);
-		iowait = ts->iowait_sleeptime;
-	} else {
-		if (ts->idle_active && nr_iowait_cpu(cpu) > 0) {
-			ktime_t delta = ktime_sub(now, ts->idle_entrytime);
-
-			iowait = ktime_add(ts->iowait_sleeptime, delta);
-		} else {
-			iowait = ts->iowait_sleeptime;
-		}
-	}
-
-	return ktime_to_us(iowait);
+	return iowait;
 }
 EXPORT_SYMBOL_GPL(get_cpu_iowait_time_us);
 
@@ -321,6 +779,7 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 	unsigned long seq, last_jiffies, next_jiffies, delta_jiffies;
 	ktime_t last_update, expires, ret = { .tv64 = 0 };
 	unsigned long rcu_delta_jiffies;
+	int rcu_needs, irq_work_needs;
 	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
 	u64 time_delta;
 
@@ -332,10 +791,16 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 		time_delta = timekeeping_max_deferment();
 	} while (read_seqretry(&jiffies_lock, seq));
 
-	if (rcu_needs_cpu(cpu, &rcu_delta_jiffies) ||
-	    arch_needs_cpu(cpu) || irq_work_needs_cpu()) {
+	rcu_needs = rcu_needs_cpu(cpu, &rcu_delta_jiffies);
+	irq_work_needs = irq_work_needs_cpu();
+	if (rcu_needs || arch_needs_cpu(cpu) || irq_work_needs) {
 		next_jiffies = last_jiffies + 1;
 		delta_jiffies = 1;
+		if (!ts->inidle)
+			trace_tick_stop(0, rcu_needs ? TICK_DEP_MASK_RCU :
+					irq_work_needs ?
+					TICK_DEP_MASK_IRQ_WORK :
+					TICK_DEP_MASK_NONE);
 	} else {
 		/* Get the next timer wheel timer */
 		next_jiffies = get_next_timer_interrupt(last_jiffies);
@@ -371,6 +836,9 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 		if (cpu == tick_do_timer_cpu) {
 			tick_do_timer_cpu = TICK_DO_TIMER_NONE;
 			ts->do_timer_last = 1;
+#ifdef CONFIG_NO_HZ_FULL
+			tick_do_timer_last_cpu = cpu;
+#endif
 		} else if (tick_do_timer_cpu != TICK_DO_TIMER_NONE) {
 			time_delta = KTIME_MAX;
 			ts->do_timer_last = 0;
@@ -418,9 +886,16 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 		if (!ts->tick_stopped) {
 			nohz_balance_enter_idle(cpu);
 			calc_load_enter_idle();
+			quiet_vmstat();
 
 			ts->last_tick = hrtimer_get_expires(&ts->sched_timer);
 			ts->tick_stopped = 1;
+#ifdef CONFIG_NO_HZ_FULL
+			if (!ts->inidle) {
+				tick_nohz_full_busy_enter(ts);
+				trace_tick_stop(1, TICK_DEP_MASK_NONE);
+			}
+#endif
 		}
 
 		/*
@@ -457,6 +932,26 @@ out:
 	return ret;
 }
 
+static void tick_nohz_restart_sched_tick(struct tick_sched *ts, ktime_t now);
+
+static void tick_nohz_full_update_tick(struct tick_sched *ts)
+{
+#ifdef CONFIG_NO_HZ_FULL
+	int cpu = smp_processor_id();
+
+	if (!tick_nohz_full_cpu(cpu) || is_idle_task(current))
+		return;
+
+	if (!ts->tick_stopped && ts->nohz_mode == NOHZ_MODE_INACTIVE)
+		return;
+
+	if (can_stop_full_tick(ts))
+		tick_nohz_stop_sched_tick(ts, ktime_get(), cpu);
+	else if (ts->tick_stopped)
+		tick_nohz_restart_sched_tick(ts, ktime_get());
+#endif
+}
+
 static bool can_stop_idle_tick(int cpu, struct tick_sched *ts)
 {
 	/*
@@ -477,6 +972,13 @@ static bool can_stop_idle_tick(int cpu, struct tick_sched *ts)
 	if (need_resched())
 		return false;
 
+	/*
+	 * Keep the tick alive on the timekeeper while full dynticks CPUs
+	 * are busy, they rely on it for the jiffies and walltime updates.
+	 */
+	if (tick_nohz_full_keep_tick(cpu))
+		return false;
+
 	if (unlikely(local_softirq_pending() && cpu_online(cpu))) {
 		static int ratelimit;
 
@@ -550,6 +1052,7 @@ void tick_nohz_idle_enter(void)
 	 * update of the idle time accounting in tick_nohz_start_idle().
 	 */
 	ts->inidle = 1;
+	tick_nohz_full_busy_exit(ts);
 	__tick_nohz_idle_enter(ts);
 
 	local_irq_enable();
@@ -563,17 +1066,21 @@ EXPORT_SYMBOL_GPL(tick_nohz_idle_enter);
  * a reschedule, it may still add, modify or delete a timer, enqueue
  * an RCU callback, etc...
  * So we need to re-calculate and reprogram the next tick event.
+ *
+ * On full dynticks CPUs, this is also where we try to stop the tick
+ * while running a single task.
  */
 void tick_nohz_irq_exit(void)
 {
 	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
 
-	if (!ts->inidle)
-		return;
-
-	/* Cancel the timer because CPU already waken up from the C-states*/
-	menu_hrtimer_cancel();
-	__tick_nohz_idle_enter(ts);
+	if (ts->inidle) {
+		/* Cancel the timer because CPU already waken up from the C-states*/
+		menu_hrtimer_cancel();
+		__tick_nohz_idle_enter(ts);
+	} else {
+		tick_nohz_full_update_tick(ts);
+	}
 }
 
 /**
@@ -627,6 +1134,7 @@ static void tick_nohz_restart_sched_tick(struct tick_sched *ts, ktime_t now)
 	 */
 	ts->tick_stopped  = 0;
 	ts->idle_exittime = now;
+	tick_nohz_full_busy_exit(ts);
 
 	tick_nohz_restart(ts, now);
 }
@@ -146,6 +146,9 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 	SEQ_printf(m, "  .%-15s: %Lu nsecs\n", #x, \
 		   (unsigned long long)(ktime_to_ns(cpu_base->x)))
 
+	P(nr_unmovable);
+	SEQ_printf(m, "  .%-15s: %Lu\n", "nr_wheel_unmovable",
+		   (unsigned long long)timer_nr_unmovable(cpu));
 #ifdef CONFIG_HIGH_RES_TIMERS
 	P_ns(expires_next);
 	P(hres_active);
@@ -153,6 +156,7 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 	P(nr_retries);
 	P(nr_hangs);
 	P_ns(max_hang_time);
+	P(nr_reprograms_saved);
 #endif
 #undef P
 #undef P_ns
@@ -259,7 +263,7 @@ static int timer_list_show(struct seq_file *m, void *v)
 	u64 now = ktime_to_ns(ktime_get());
 	int cpu;
 
-	SEQ_printf(m, "Timer List Version: v0.7\n");
+	SEQ_printf(m, "Timer List Version: v0.8\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 
@@ -56,35 +56,68 @@ u64 jiffies_64 __cacheline_aligned_in_smp = INITIAL_JIFFIES;
 EXPORT_SYMBOL(jiffies_64);
 
 /*
- * per-CPU timer vector definitions:
+ * per-CPU timer wheel definitions:
+ *
+ * The wheel has LVL_DEPTH levels of LVL_SIZE buckets each. Every level
+ * runs its own clock: the granularity of level n is LVL_CLK_DIV^n
+ * jiffies. A timer is queued in the level that covers its relative
+ * expiry time and stays there until it expires, timers are never
+ * cascaded down to the lower levels. The expiry time of the timers in
+ * the upper levels is rounded up to the level granularity, which
+ * batches their expiry.
+ *
+ * This is good enough for the vast majority of the timers which are
+ * timeouts canceled before they expire, the short ones (networking)
+ * fit into the first level which has exact jiffy granularity. With
+ * HZ=1000 the levels are:
+ *
+ * Level Offset  Granularity            Range
+ *  0      0         1 ms                0 ms -         62 ms
+ *  1     64         8 ms               63 ms -        503 ms
+ *  2    128        64 ms              504 ms -       4031 ms
+ *  3    192       512 ms             4032 ms -      32255 ms
+ *  4    256      4096 ms (~4s)      32256 ms -     258047 ms
+ *  5    320     32768 ms (~32s)    258048 ms -    2064383 ms
+ *  6    384    262144 ms (~4m)    2064384 ms -   16515071 ms
+ *  7    448   2097152 ms (~34m)  16515072 ms -  132120575 ms
+ *  8    512  16777216 ms (~4h)  132120576 ms - 1056964607 ms (~12d)
+ *
+ * Timers beyond the capacity of the last level are force expired at
+ * the maximum timeout of the wheel.
  */
-#define TVN_BITS (CONFIG_BASE_SMALL ? 4 : 6)
-#define TVR_BITS (CONFIG_BASE_SMALL ? 6 : 8)
-#define TVN_SIZE (1 << TVN_BITS)
-#define TVR_SIZE (1 << TVR_BITS)
-#define TVN_MASK (TVN_SIZE - 1)
-#define TVR_MASK (TVR_SIZE - 1)
-#define MAX_TVAL ((unsigned long)((1ULL << (TVR_BITS + 4*TVN_BITS)) - 1))
-
-struct tvec {
-	struct list_head vec[TVN_SIZE];
-};
+#define LVL_CLK_SHIFT	3
+#define LVL_CLK_DIV	(1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK	(LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n)	((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)	(1UL << LVL_SHIFT(n))
+
+#define LVL_BITS	6
+#define LVL_SIZE	(1UL << LVL_BITS)
+#define LVL_MASK	(LVL_SIZE - 1)
+#define LVL_OFFS(n)	((n) * LVL_SIZE)
+
+/* First relative expiry time covered by level n (n > 0) */
+#define LVL_START(n)	((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+#if HZ > 100
+# define LVL_DEPTH	9
+#else
+# define LVL_DEPTH	8
+#endif
 
-struct tvec_root {
-	struct list_head vec[TVR_SIZE];
-};
+#define WHEEL_TIMEOUT_CUTOFF	(LVL_START(LVL_DEPTH))
+#define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+#define WHEEL_SIZE		(LVL_SIZE * LVL_DEPTH)
 
 struct tvec_base {
 	spinlock_t lock;
 	struct timer_list *running_timer;
 	unsigned long timer_jiffies;
-	unsigned long next_timer;
 	unsigned long active_timers;
-	struct tvec_root tv1;
-	struct tvec tv2;
-	struct tvec tv3;
-	struct tvec tv4;
-	struct tvec tv5;
+	unsigned long nr_unmovable;
+	int cpu;
+	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
+	struct list_head vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
 
 struct tvec_base boot_tvec_bases;
@@ -334,61 +367,170 @@ void set_timer_slack(struct timer_list *timer, int slack_hz)
 }
 EXPORT_SYMBOL_GPL(set_timer_slack);
 
-static void
-__internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+/*
+ * Bucket index of @expires in level @lvl. The expiry time is rounded
+ * up to the level granularity so that a timer never fires early.
+ */
+static inline unsigned int calc_index(unsigned long expires, unsigned int lvl)
 {
-	unsigned long expires = timer->expires;
-	unsigned long idx = expires - base->timer_jiffies;
-	struct list_head *vec;
+	expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
+/* Jiffy at which the bucket of @expires in level @lvl expires */
+static inline unsigned long calc_bucket_expiry(unsigned long expires,
+					       unsigned int lvl)
+{
+	expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+	return expires << LVL_SHIFT(lvl);
+}
+
+static unsigned int calc_wheel_index(unsigned long expires, unsigned long clk)
+{
+	unsigned long delta = expires - clk;
+	unsigned int lvl;
+
+	/*
+	 * Can happen if you add a timer with expires == jiffies,
+	 * or you set a timer to go off in the past
+	 */
+	if ((long)delta < 0)
+		return clk & LVL_MASK;
+
+	/* Force expire obscene large timeouts at the capacity limit */
+	if (delta >= WHEEL_TIMEOUT_CUTOFF) {
+		expires = clk + WHEEL_TIMEOUT_MAX;
+		delta = WHEEL_TIMEOUT_MAX;
+	}
+
+	for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++) {
+		if (delta < LVL_START(lvl + 1))
+			break;
+	}
+	return calc_index(expires, lvl);
+}
+
+/* Check whether a bucket holds a timer that can wake up an idle cpu */
+static bool bucket_has_active_timer(struct list_head *vec)
+{
+	struct timer_list *timer;
+
+	list_for_each_entry(timer, vec, entry) {
+		if (!tbase_get_deferrable(timer->base))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Search the level starting at @offset for the first pending bucket
+ * from position @clk on, wrapping around. Returns its distance to @clk
+ * or -1 if the level is empty.
+ */
+static int next_pending_bucket(struct tvec_base *base, unsigned int offset,
+			       unsigned int clk, bool skip_deferrable)
+{
+	unsigned int pos, start = offset + clk;
+	unsigned int end = offset + LVL_SIZE;
+
+	for (pos = find_next_bit(base->pending_map, end, start); pos < end;
+	     pos = find_next_bit(base->pending_map, end, pos + 1)) {
+		if (!skip_deferrable ||
+		    bucket_has_active_timer(base->vectors + pos))
+			return pos - start;
+	}
+
+	for (pos = find_next_bit(base->pending_map, start, offset); pos < start;
+	     pos = find_next_bit(base->pending_map, start, pos + 1)) {
+		if (!skip_deferrable ||
+		    bucket_has_active_timer(base->vectors + pos))
+			return pos + LVL_SIZE - start;
+	}
+
+	return -1;
+}
+
+/*
+ * Find the jiffy at which the next pending bucket expires. Deferrable
+ * timers are ignored if @skip_deferrable is set.
+ * Must be called with the base lock held.
+ */
+static unsigned long __next_timer_interrupt(struct tvec_base *base,
+					    bool skip_deferrable)
+{
+	unsigned long clk, next, adj;
+	unsigned int lvl, offset = 0;
+
+	clk = base->timer_jiffies;
+	next = clk + NEXT_TIMER_MAX_DELTA;
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++, offset += LVL_SIZE) {
+		int pos = next_pending_bucket(base, offset, clk & LVL_MASK,
+					      skip_deferrable);
 
-	if (idx < TVR_SIZE) {
-		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
-	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
-		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = base->tv2.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec = base->tv3.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv4.vec + i;
-	} else if ((signed long) idx < 0) {
+		if (pos >= 0) {
+			unsigned long tmp = clk + (unsigned long)pos;
+
+			tmp <<= LVL_SHIFT(lvl);
+			if (time_before(tmp, next))
+				next = tmp;
+		}
 		/*
-		 * Can happen if you add a timer with expires == jiffies,
-		 * or you set a timer to go off in the past
+		 * Clock of the next level: if the lower bits of the
+		 * current level clock are not zero, the next bucket to
+		 * expire in the next level is the following one.
 		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
-	} else {
-		int i;
-		/* If the timeout is larger than MAX_TVAL (on 64-bit
-		 * architectures or with CONFIG_BASE_SMALL=1) then we
-		 * use the maximum timeout.
-		 */
-		if (idx > MAX_TVAL) {
-			idx = MAX_TVAL;
-			expires = idx + base->timer_jiffies;
-		}
-		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv5.vec + i;
+		adj = clk & LVL_CLK_MASK ? 1 : 0;
+		clk >>= LVL_CLK_SHIFT;
+		clk += adj;
 	}
+	return next;
+}
+
+/*
+ * The base clock only moves forward when the timer softirq runs, so it
+ * lags behind jiffies after a dynticks idle sleep. Catch up before
+ * queueing a timer, otherwise its relative expiry time and thus its
+ * level granularity would be overestimated. Stop at the next pending
+ * bucket so that no timer is skipped.
+ */
+static void forward_timer_base(struct tvec_base *base)
+{
+	unsigned long jnow = ACCESS_ONCE(jiffies);
+	unsigned long next;
+
+	if ((long)(jnow - base->timer_jiffies) < 2)
+		return;
+
+	next = __next_timer_interrupt(base, false);
+	if (time_after(next, jnow))
+		base->timer_jiffies = jnow;
+	else
+		base->timer_jiffies = next;
+}
+
+static void
+__internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+{
+	unsigned int idx = calc_wheel_index(timer->expires,
+					    base->timer_jiffies);
+
+	timer->wheel_idx = idx;
 	/*
 	 * Timers are FIFO:
 	 */
-	list_add_tail(&timer->entry, vec);
+	list_add_tail(&timer->entry, base->vectors + idx);
+	__set_bit(idx, base->pending_map);
 }
 
 static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
 {
+	forward_timer_base(base);
 	__internal_add_timer(base, timer);
 	/*
-	 * Update base->active_timers and base->next_timer
+	 * Update base->active_timers
 	 */
-	if (!tbase_get_deferrable(timer->base)) {
-		if (time_before(timer->expires, base->next_timer))
-			base->next_timer = timer->expires;
+	if (!tbase_get_deferrable(timer->base))
 		base->active_timers++;
-	}
 }
 
 #ifdef CONFIG_TIMER_STATS
@@ -673,15 +815,23 @@ detach_expired_timer(struct timer_list *timer, struct tvec_base *base)
 static int detach_if_pending(struct timer_list *timer, struct tvec_base *base,
 			     bool clear_pending)
 {
+	struct list_head *vec;
+
 	if (!timer_pending(timer))
 		return 0;
 
+	vec = base->vectors + timer->wheel_idx;
+
+	/*
+	 * Last timer of its bucket? The timer may also sit on the expiry
+	 * list of __run_timers(), in which case the bucket isn't touched.
+	 */
+	if (timer->entry.next == vec && timer->entry.prev == vec)
+		__clear_bit(timer->wheel_idx, base->pending_map);
+
 	detach_timer(timer, clear_pending);
-	if (!tbase_get_deferrable(timer->base)) {
+	if (!tbase_get_deferrable(timer->base))
 		base->active_timers--;
-		if (timer->expires == base->next_timer)
-			base->next_timer = base->timer_jiffies;
-	}
 	return 1;
 }
 
@@ -730,17 +880,38 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 
 	base = lock_timer_base(timer, &flags);
 
+	/*
+	 * A re-armed timer whose new expiry time lands in the same bucket
+	 * only needs its expiry time to be updated, it keeps its place in
+	 * the wheel. Buckets are reused once per level period, so compare
+	 * the bucket expiry times too: this also excludes a timer already
+	 * collected by __run_timers().
+	 */
+	if (timer_pending(timer)) {
+		unsigned int idx, lvl;
+
+		forward_timer_base(base);
+		idx = calc_wheel_index(expires, base->timer_jiffies);
+		lvl = idx / LVL_SIZE;
+		if (idx == timer->wheel_idx &&
+		    calc_bucket_expiry(expires, lvl) ==
+		    calc_bucket_expiry(timer->expires, lvl)) {
+			timer->expires = expires;
+			ret = 1;
+			goto out_unlock;
+		}
+	}
+
 	ret = detach_if_pending(timer, base, false);
 	if (!ret && pending_only)
 		goto out_unlock;
 
 	debug_activate(timer, expires);
 
-	cpu = smp_processor_id();
-
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
-		cpu = get_nohz_timer_target();
+	cpu = get_nohz_timer_target(pinned);
+#else
+	cpu = smp_processor_id();
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
 
@@ -765,6 +936,21 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	timer->expires = expires;
 	internal_add_timer(base, timer);
 
+	/*
+	 * A timer that should have left a full dynticks CPU but is still
+	 * running its callback there stays on that CPU.
+	 */
+	if (!pinned && !is_housekeeping_cpu(base->cpu))
+		base->nr_unmovable++;
+
+	/*
+	 * The target CPU may run with its tick stopped, either idle or in
+	 * full dynticks mode, and must re-evaluate its timer wheel to take
+	 * this new timer into account.
+	 */
+	if (base == new_base)
+		wake_up_nohz_cpu(cpu);
+
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
 
@@ -930,18 +1116,31 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	debug_activate(timer, timer->expires);
 	internal_add_timer(base, timer);
 	/*
-	 * Check whether the other CPU is idle and needs to be
-	 * triggered to reevaluate the timer wheel when nohz is
-	 * active. We are protected against the other CPU fiddling
-	 * with the timer by holding the timer base lock. This also
-	 * makes sure that a CPU on the way to idle can not evaluate
-	 * the timer wheel.
+	 * Check whether the other CPU is in dynticks mode and needs
+	 * to be triggered to reevaluate the timer wheel. We are
+	 * protected against the other CPU fiddling with the timer by
+	 * holding the timer base lock. This also makes sure that a
+	 * CPU on the way to stop its tick can not evaluate the timer
+	 * wheel.
 	 */
-	wake_up_idle_cpu(cpu);
+	wake_up_nohz_cpu(cpu);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
 
+/**
+ * timer_nr_unmovable - number of timers stuck on a full dynticks CPU
+ * @cpu: the CPU to query
+ *
+ * Returns the number of non-pinned timers that have been enqueued on the
+ * timer wheel of @cpu because they could not be moved to a housekeeping
+ * CPU.
+ */
+unsigned long timer_nr_unmovable(int cpu)
+{
+	return per_cpu(tvec_bases, cpu)->nr_unmovable;
+}
+
 /**
  * del_timer - deactive a timer.
  * @timer: the timer to be deactivated
@@ -1065,27 +1264,6 @@ int del_timer_sync(struct timer_list *timer)
 EXPORT_SYMBOL(del_timer_sync);
 #endif
 
-static int cascade(struct tvec_base *base, struct tvec *tv, int index)
-{
-	/* cascade all the timers from tv up one level */
-	struct timer_list *timer, *tmp;
-	struct list_head tv_list;
-
-	list_replace_init(tv->vec + index, &tv_list);
-
-	/*
-	 * We are removing _all_ timers from the list, so we
-	 * don't have to detach them individually.
-	 */
-	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
-		BUG_ON(tbase_get_base(timer->base) != base);
-		/* No accounting, while moving them */
-		__internal_add_timer(base, timer);
-	}
-
-	return index;
-}
-
 static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 			  unsigned long data)
 {
@@ -1129,141 +1307,105 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 	}
 }
 
-#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
+static void expire_timers(struct tvec_base *base, struct list_head *head)
+{
+	while (!list_empty(head)) {
+		struct timer_list *timer;
+		void (*fn)(unsigned long);
+		unsigned long data;
+		bool irqsafe;
+
+		timer = list_first_entry(head, struct timer_list, entry);
+		fn = timer->function;
+		data = timer->data;
+		irqsafe = tbase_get_irqsafe(timer->base);
+
+		timer_stats_account_timer(timer);
+
+		base->running_timer = timer;
+		detach_expired_timer(timer, base);
+
+		if (irqsafe) {
+			spin_unlock(&base->lock);
+			call_timer_fn(timer, fn, data);
+			spin_lock(&base->lock);
+		} else {
+			spin_unlock_irq(&base->lock);
+			call_timer_fn(timer, fn, data);
+			spin_lock_irq(&base->lock);
+		}
+	}
+}
+
+/*
+ * Move the buckets expiring at the current base clock to @heads, one
+ * per level. The upper levels are only looked at when the clock of the
+ * level below wraps.
+ */
+static int collect_expired_timers(struct tvec_base *base,
+				  struct list_head *heads)
+{
+	unsigned long clk, now = ACCESS_ONCE(jiffies);
+	unsigned int idx;
+	int i, levels = 0;
+
+	/*
+	 * After a long dynticks idle sleep, forward the base to the next
+	 * expiring bucket instead of walking all the empty ones. jiffies is
+	 * sampled once: a tick in between must not skip unchecked buckets.
+	 */
+	if ((long)(now - base->timer_jiffies) > 2) {
+		unsigned long next = __next_timer_interrupt(base, false);
+
+		if (time_after(next, now)) {
+			/* The caller increments the clock */
+			base->timer_jiffies = now - 1;
+			return 0;
+		}
+		base->timer_jiffies = next;
+	}
+
+	clk = base->timer_jiffies;
+	for (i = 0; i < LVL_DEPTH; i++) {
+		idx = (clk & LVL_MASK) + i * LVL_SIZE;
+
+		if (__test_and_clear_bit(idx, base->pending_map)) {
+			list_replace_init(base->vectors + idx, heads + levels);
+			levels++;
+		}
+
+		/* Is it time to look at the next level? */
+		if (clk & LVL_CLK_MASK)
+			break;
+		/* Shift clock for the next level granularity */
+		clk >>= LVL_CLK_SHIFT;
+	}
+	return levels;
+}
 
 /**
  * __run_timers - run all expired timers (if any) on this CPU.
  * @base: the timer vector to be processed.
  *
- * This function cascades all vectors and executes all expired timer
- * vectors.
+ * This function executes all the expired buckets of the timer wheel.
  */
 static inline void __run_timers(struct tvec_base *base)
 {
-	struct timer_list *timer;
+	struct list_head heads[LVL_DEPTH];
+	int levels;
 
 	spin_lock_irq(&base->lock);
 	while (time_after_eq(jiffies, base->timer_jiffies)) {
-		struct list_head work_list;
-		struct list_head *head = &work_list;
-		int index = base->timer_jiffies & TVR_MASK;
-
-		/*
-		 * Cascade timers:
-		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
-				(!cascade(base, &base->tv3, INDEX(1))) &&
-					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
+		levels = collect_expired_timers(base, heads);
 		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, &work_list);
-		while (!list_empty(head)) {
-			void (*fn)(unsigned long);
-			unsigned long data;
-			bool irqsafe;
-
-			timer = list_first_entry(head, struct timer_list,entry);
-			fn = timer->function;
-			data = timer->data;
-			irqsafe = tbase_get_irqsafe(timer->base);
-
-			timer_stats_account_timer(timer);
-
-			base->running_timer = timer;
-			detach_expired_timer(timer, base);
-
-			if (irqsafe) {
-				spin_unlock(&base->lock);
-				call_timer_fn(timer, fn, data);
-				spin_lock(&base->lock);
-			} else {
-				spin_unlock_irq(&base->lock);
-				call_timer_fn(timer, fn, data);
-				spin_lock_irq(&base->lock);
-			}
-		}
+		while (levels--)
+			expire_timers(base, heads + levels);
 	}
 	base->running_timer = NULL;
 	spin_unlock_irq(&base->lock);
 }
 
 #ifdef CONFIG_NO_HZ
-/*
- * Find out when the next timer event is due to happen. This
- * is used on S/390 to stop all activity when a CPU is idle.
- * This function needs to be called with interrupts disabled.
- */
-static unsigned long __next_timer_interrupt(struct tvec_base *base)
-{
-	unsigned long timer_jiffies = base->timer_jiffies;
-	unsigned long expires = timer_jiffies + NEXT_TIMER_MAX_DELTA;
-	int index, slot, array, found = 0;
-	struct timer_list *nte;
-	struct tvec *varray[4];
-
-	/* Look for timer events in tv1. */
-	index = slot = timer_jiffies & TVR_MASK;
-	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
-			if (tbase_get_deferrable(nte->base))
-				continue;
-
-			found = 1;
-			expires = nte->expires;
-			/* Look at the cascade bucket(s)? */
-			if (!index || slot < index)
-				goto cascade;
-			return expires;
-		}
-		slot = (slot + 1) & TVR_MASK;
-	} while (slot != index);
-
-cascade:
-	/* Calculate the next cascade event */
-	if (index)
-		timer_jiffies += TVR_SIZE - index;
-	timer_jiffies >>= TVR_BITS;
-
-	/* Check tv2-tv5. */
-	varray[0] = &base->tv2;
-	varray[1] = &base->tv3;
-	varray[2] = &base->tv4;
-	varray[3] = &base->tv5;
-
-	for (array = 0; array < 4; array++) {
-		struct tvec *varp = varray[array];
-
-		index = slot = timer_jiffies & TVN_MASK;
-		do {
-			list_for_each_entry(nte, varp->vec + slot, entry) {
-				if (tbase_get_deferrable(nte->base))
-					continue;
-
-				found = 1;
-				if (time_before(nte->expires, expires))
-					expires = nte->expires;
-			}
-			/*
-			 * Do we still search for the first timer or are
-			 * we looking up the cascade buckets ?
-			 */
-			if (found) {
-				/* Look at the cascade bucket(s)? */
-				if (!index || slot < index)
-					break;
-				return expires;
-			}
-			slot = (slot + 1) & TVN_MASK;
-		} while (slot != index);
-
-		if (index)
-			timer_jiffies += TVN_SIZE - index;
-		timer_jiffies >>= TVN_BITS;
-	}
-	return expires;
-}
-
 /*
  * Check, if the next hrtimer event is before the next timer wheel
  * event:
@@ -1325,11 +1467,8 @@ unsigned long get_next_timer_interrupt(unsigned long now)
 		return expires;
 
 	spin_lock(&base->lock);
-	if (base->active_timers) {
-		if (time_before_eq(base->next_timer, base->timer_jiffies))
-			base->next_timer = __next_timer_interrupt(base);
-		expires = base->next_timer;
-	}
+	if (base->active_timers)
+		expires = __next_timer_interrupt(base, true);
 	spin_unlock(&base->lock);
 
 	if (time_before_eq(expires, now))
@@ -1357,7 +1496,6 @@ void update_process_times(int user_tick)
 		irq_work_run();
 #endif
 	scheduler_tick();
-	run_posix_cpu_timers(p);
 }
 
 /*
@@ -1685,18 +1823,13 @@ static int __cpuinit init_timers_cpu(int cpu)
 
 	spin_lock_init(&base->lock);
 
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
-	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	for (j = 0; j < WHEEL_SIZE; j++)
+		INIT_LIST_HEAD(base->vectors + j);
+	bitmap_zero(base->pending_map, WHEEL_SIZE);
 
 	base->timer_jiffies = jiffies;
-	base->next_timer = base->timer_jiffies;
 	base->active_timers = 0;
+	base->cpu = cpu;
 	return 0;
 }
 
@@ -1732,14 +1865,8 @@ static void __cpuinit migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
-	for (i = 0; i < TVN_SIZE; i++) {
-		migrate_timer_list(new_base, old_base->tv2.vec + i);
-		migrate_timer_list(new_base, old_base->tv3.vec + i);
-		migrate_timer_list(new_base, old_base->tv4.vec + i);
-		migrate_timer_list(new_base, old_base->tv5.vec + i);
-	}
+	for (i = 0; i < WHEEL_SIZE; i++)
+		migrate_timer_list(new_base, old_base->vectors + i);
 
 	spin_unlock(&old_base->lock);
 	spin_unlock_irq(&new_base->lock);
@@ -0,0 +1,170 @@
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/delay.h>
+#include <asm/timex.h>
+
+/*
+ * A benchmark of the timer wheel for timeout-heavy workloads: a large
+ * number of timers armed a few seconds ahead, re-armed many times and
+ * mostly deleted before they expire, as networking does. Load it on the
+ * kernels to compare, the results are printed and the module unloads
+ * right away.
+ */
+
+static unsigned int nr_timers = 100000;
+module_param(nr_timers, uint, 0444);
+MODULE_PARM_DESC(nr_timers, "Number of timeout timers");
+
+static unsigned int rearm_loops = 10;
+module_param(rearm_loops, uint, 0444);
+MODULE_PARM_DESC(rearm_loops, "Number of re-arm passes over all the timers");
+
+static unsigned int nr_expiring = 1000;
+module_param(nr_expiring, uint, 0444);
+MODULE_PARM_DESC(nr_expiring, "Number of timers measured for expiry latency");
+
+static struct timer_list *timers;
+static unsigned long *fired;
+static atomic_t nr_fired;
+
+static struct rnd_state rnd;
+
+/* A networking like timeout: between 1 and 10 seconds */
+static unsigned long random_timeout(void)
+{
+	return HZ + prandom_u32_state(&rnd) % (9 * HZ);
+}
+
+static void timeout_fn(unsigned long data)
+{
+	/* Deleted before expiry, hitting this means the box is too slow */
+}
+
+static void expiry_fn(unsigned long data)
+{
+	fired[data] = jiffies;
+	atomic_inc(&nr_fired);
+}
+
+static void report(const char *what, cycles_t time, unsigned long ops)
+{
+	time = div_u64(time, ops);
+	printk(KERN_ALERT "timer wheel test: %s -> %llu cycles\n", what,
+	       (unsigned long long)time);
+}
+
+static void bench_timeouts(void)
+{
+	cycles_t time1, time2;
+	unsigned int i, j;
+
+	for (i = 0; i < nr_timers; i++)
+		setup_timer(timers + i, timeout_fn, i);
+
+	time1 = get_cycles();
+	for (i = 0; i < nr_timers; i++)
+		mod_timer(timers + i, jiffies + random_timeout());
+	time2 = get_cycles();
+	report("arm", time2 - time1, nr_timers);
+
+	/* Re-arm further away, as on every ack of a connection */
+	time1 = get_cycles();
+	for (j = 0; j < rearm_loops; j++) {
+		for (i = 0; i < nr_timers; i++)
+			mod_timer(timers + i, jiffies + random_timeout());
+	}
+	time2 = get_cycles();
+	report("re-arm", time2 - time1, (unsigned long)nr_timers * rearm_loops);
+
+	time1 = get_cycles();
+	for (i = 0; i < nr_timers; i++)
+		del_timer(timers + i);
+	time2 = get_cycles();
+	report("delete", time2 - time1, nr_timers);
+
+	for (i = 0; i < nr_timers; i++)
+		del_timer_sync(timers + i);
+}
+
+static void bench_expiry(void)
+{
+	unsigned long *expires, late, max_late = 0, sum_late = 0;
+	unsigned int i, nr = min(nr_expiring, nr_timers);
+	int wait;
+
+	expires = vmalloc(nr * sizeof(*expires));
+	if (!expires)
+		return;
+
+	atomic_set(&nr_fired, 0);
+	for (i = 0; i < nr; i++) {
+		setup_timer(timers + i, expiry_fn, i);
+		/* Spread over the first levels of the wheel */
+		expires[i] = jiffies + 1 + prandom_u32_state(&rnd) % (2 * HZ);
+		mod_timer(timers + i, expires[i]);
+	}
+
+	for (wait = 0; wait < 10 && atomic_read(&nr_fired) < nr; wait++)
+		msleep(1000);
+
+	for (i = 0; i < nr; i++)
+		del_timer_sync(timers + i);
+
+	if (atomic_read(&nr_fired) < nr) {
+		printk(KERN_ALERT "timer wheel test: only %d/%u timers expired\n",
+		       atomic_read(&nr_fired), nr);
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		WARN_ON_ONCE(time_before(fired[i], expires[i]));
+		late = fired[i] - expires[i];
+		sum_late += late;
+		max_late = max(max_late, late);
+	}
+	printk(KERN_ALERT "timer wheel test: expiry late by %lu jiffies average, %lu max\n",
+	       sum_late / nr, max_late);
+out:
+	vfree(expires);
+}
+
+static int timer_wheel_test_init(void)
+{
+	printk(KERN_ALERT "timer wheel testing with %u timers\n", nr_timers);
+
+	if (!nr_timers)
+		return -EINVAL;
+
+	timers = vmalloc(nr_timers * sizeof(*timers));
+	fired = vmalloc(nr_timers * sizeof(*fired));
+	if (!timers || !fired) {
+		vfree(timers);
+		vfree(fired);
+		return -ENOMEM;
+	}
+
+	prandom_seed_state(&rnd, 3141592653589793238ULL);
+
+	bench_timeouts();
+	bench_expiry();
+
+	vfree(fired);
+	vfree(timers);
+
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void timer_wheel_test_exit(void)
+{
+	printk(KERN_ALERT "test exit\n");
+}
+
+module_init(timer_wheel_test_init)
+module_exit(timer_wheel_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Timer wheel benchmark");
@@ -197,7 +197,7 @@ static int do_mmu_notifier_register(struct mmu_notifier *mn,
 	 * Verify that mmu_notifier_init() already run and the global srcu is
 	 * initialized.
 	 */
-	BUG_ON(!srcu.per_cpu_ref);
+	BUG_ON(!srcu.sda);
 
 	ret = -ENOMEM;
 	mmu_notifier_mm = kmalloc(sizeof(struct mmu_notifier_mm), GFP_KERNEL);
@@ -392,6 +392,11 @@ static void __activate_page(struct page *page, struct lruvec *lruvec,
 #ifdef CONFIG_SMP
 static DEFINE_PER_CPU(struct pagevec, activate_page_pvecs);
 
+static bool need_activate_page_drain(int cpu)
+{
+	return pagevec_count(&per_cpu(activate_page_pvecs, cpu)) != 0;
+}
+
 static void activate_page_drain(int cpu)
 {
 	struct pagevec *pvec = &per_cpu(activate_page_pvecs, cpu);
@@ -417,6 +422,11 @@ static inline void activate_page_drain(int cpu)
 {
 }
 
+static inline bool need_activate_page_drain(int cpu)
+{
+	return false;
+}
+
 void activate_page(struct page *page)
 {
 	struct zone *zone = page_zone(page);
@@ -647,11 +657,51 @@ static void lru_add_drain_per_cpu(struct work_struct *dummy)
 }
 
 /*
+ * Check if any of the cpu's pagevecs holds pages. This reads remote
+ * pagevecs racily: pages added concurrently may be missed, just like
+ * pages added right after the drain.
+ */
+static bool lru_add_drain_needed(int cpu)
+{
+	struct pagevec *pvecs = per_cpu(lru_add_pvecs, cpu);
+	int lru;
+
+	for_each_lru(lru) {
+		if (pagevec_count(&pvecs[lru - LRU_BASE]))
+			return true;
+	}
+
+	return pagevec_count(&per_cpu(lru_rotate_pvecs, cpu)) ||
+	       pagevec_count(&per_cpu(lru_deactivate_pvecs, cpu)) ||
+	       need_activate_page_drain(cpu);
+}
+
+/*
+ * Drain the pagevecs of all the cpus that hold some pages, the other
+ * cpus are not disturbed.
+ *
  * Returns 0 for success
  */
 int lru_add_drain_all(void)
 {
-	return schedule_on_each_cpu(lru_add_drain_per_cpu);
+	/*
+	 * Allocate in the BSS so we don't require allocation for
+	 * CONFIG_CPUMASK_OFFSTACK=y, serialized by lock.
+	 */
+	static DEFINE_MUTEX(lock);
+	static struct cpumask has_work;
+	int cpu, ret;
+
+	mutex_lock(&lock);
+	cpumask_clear(&has_work);
+	for_each_online_cpu(cpu) {
+		if (lru_add_drain_needed(cpu))
+			cpumask_set_cpu(cpu, &has_work);
+	}
+	ret = schedule_on_cpu_mask(lru_add_drain_per_cpu, &has_work);
+	mutex_unlock(&lock);
+
+	return ret;
 }
 
 /*
@@ -19,6 +19,7 @@
 #include <linux/math64.h>
 #include <linux/writeback.h>
 #include <linux/compaction.h>
+#include <linux/tick.h>
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 DEFINE_PER_CPU(struct vm_event_state, vm_event_states) = {{0}};
@@ -433,12 +434,18 @@ EXPORT_SYMBOL(dec_zone_page_state);
  * statistics in the remote zone struct as well as the global cachelines
  * with the global counters. These could cause remote node cache line
  * bouncing and will have to be only done when necessary.
+ *
+ * The number of folded differentials and pending pageset drains is
+ * returned so that the caller knows whether the cpu is still active.
+ * The pagesets are left alone if @do_pagesets is false, in which case
+ * this doesn't sleep and can be called with interrupts disabled.
  */
-void refresh_cpu_vm_stats(int cpu)
+static int __refresh_cpu_vm_stats(int cpu, bool do_pagesets)
 {
 	struct zone *zone;
 	int i;
 	int global_diff[NR_VM_ZONE_STAT_ITEMS] = { 0, };
+	int changes = 0;
 
 	for_each_populated_zone(zone) {
 		struct per_cpu_pageset *p;
@@ -456,11 +463,14 @@ void refresh_cpu_vm_stats(int cpu)
 				local_irq_restore(flags);
 				atomic_long_add(v, &zone->vm_stat[i]);
 				global_diff[i] += v;
+				changes++;
 #ifdef CONFIG_NUMA
 				/* 3 seconds idle till flush */
 				p->expire = 3;
 #endif
 			}
+		if (!do_pagesets)
+			continue;
 		cond_resched();
 #ifdef CONFIG_NUMA
 		/*
@@ -482,8 +492,10 @@ void refresh_cpu_vm_stats(int cpu)
 		}
 
 		p->expire--;
-		if (p->expire)
+		if (p->expire) {
+			changes++;
 			continue;
+		}
 
 		if (p->pcp.count)
 			drain_zone_pages(zone, &p->pcp);
@@ -493,6 +505,13 @@ void refresh_cpu_vm_stats(int cpu)
 	for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++)
 		if (global_diff[i])
 			atomic_long_add(global_diff[i], &vm_stat[i]);
+
+	return changes;
+}
+
+int refresh_cpu_vm_stats(int cpu)
+{
+	return __refresh_cpu_vm_stats(cpu, true);
 }
 
 void drain_zonestat(struct zone *zone, struct per_cpu_pageset *pset)
@@ -1173,19 +1192,115 @@ static const struct file_operations proc_vmstat_file_operations = {
 static DEFINE_PER_CPU(struct delayed_work, vmstat_work);
 int sysctl_stat_interval __read_mostly = HZ;
 
+/*
+ * Cpus whose vmstat worker is stopped because they had nothing to fold.
+ * The shepherd, running on a housekeeping cpu, restarts their worker
+ * once they have differentials again.
+ */
+static cpumask_var_t cpu_stat_off;
+
 static void vmstat_update(struct work_struct *w)
 {
-	refresh_cpu_vm_stats(smp_processor_id());
-	schedule_delayed_work(&__get_cpu_var(vmstat_work),
+	if (refresh_cpu_vm_stats(smp_processor_id())) {
+		/*
+		 * Counters were updated so we expect more updates
+		 * to occur in the future. Keep on running the
+		 * update worker.
+		 */
+		schedule_delayed_work(&__get_cpu_var(vmstat_work),
+			round_jiffies_relative(sysctl_stat_interval));
+	} else {
+		/*
+		 * Nothing was folded, the cpu may be idle or running a
+		 * task that doesn't touch the counters. Leave it alone
+		 * and let the shepherd check its differentials remotely.
+		 */
+		cpumask_set_cpu(smp_processor_id(), cpu_stat_off);
+	}
+}
+
+/*
+ * Check if the differentials of a cpu indicate that an update is needed.
+ * This only reads the remote pagesets and never disturbs the cpu.
+ */
+static bool need_update(int cpu)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct per_cpu_pageset *p = per_cpu_ptr(zone->pageset, cpu);
+
+		BUILD_BUG_ON(sizeof(p->vm_stat_diff[0]) != 1);
+		if (memchr_inv(p->vm_stat_diff, 0, NR_VM_ZONE_STAT_ITEMS))
+			return true;
+#ifdef CONFIG_NUMA
+		/* Remote pageset waiting to be drained */
+		if (p->expire && p->pcp.count)
+			return true;
+#endif
+	}
+	return false;
+}
+
+/*
+ * Switch off the vmstat worker of the current cpu as it enters dynticks
+ * mode and fold its differentials right away. A still pending worker is
+ * deferrable: it won't wake the cpu up and stops on its next run. Called
+ * with interrupts disabled.
+ */
+void quiet_vmstat(void)
+{
+	int cpu = smp_processor_id();
+
+	if (system_state != SYSTEM_RUNNING)
+		return;
+
+	if (cpumask_test_and_set_cpu(cpu, cpu_stat_off))
+		return;
+
+	if (need_update(cpu))
+		__refresh_cpu_vm_stats(cpu, false);
+}
+
+static void vmstat_shepherd(struct work_struct *w);
+
+static DECLARE_DEFERRABLE_WORK(shepherd, vmstat_shepherd);
+
+static void vmstat_shepherd(struct work_struct *w)
+{
+	int cpu;
+
+	get_online_cpus();
+	/* Restart the workers of the quiet cpus that have something to fold */
+	for_each_cpu(cpu, cpu_stat_off) {
+		struct delayed_work *work = &per_cpu(vmstat_work, cpu);
+
+		if (need_update(cpu) &&
+		    cpumask_test_and_clear_cpu(cpu, cpu_stat_off))
+			schedule_delayed_work_on(cpu, work,
+				__round_jiffies_relative(sysctl_stat_interval,
+							 cpu));
+	}
+	put_online_cpus();
+
+	schedule_delayed_work_on(housekeeping_any_cpu(), &shepherd,
 		round_jiffies_relative(sysctl_stat_interval));
 }
 
-static void __cpuinit start_cpu_timer(int cpu)
+static void __init start_shepherd_timer(void)
 {
-	struct delayed_work *work = &per_cpu(vmstat_work, cpu);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		INIT_DEFERRABLE_WORK(&per_cpu(vmstat_work, cpu),
+				     vmstat_update);
+
+	if (!alloc_cpumask_var(&cpu_stat_off, GFP_KERNEL))
+		BUG();
+	cpumask_copy(cpu_stat_off, cpu_online_mask);
 
-	INIT_DEFERRABLE_WORK(work, vmstat_update);
-	schedule_delayed_work_on(cpu, work, __round_jiffies_relative(HZ, cpu));
+	schedule_delayed_work_on(housekeeping_any_cpu(), &shepherd,
+		round_jiffies_relative(sysctl_stat_interval));
 }
 
 /*
@@ -1202,17 +1317,17 @@ static int __cpuinit vmstat_cpuup_callback(struct notifier_block *nfb,
 	case CPU_ONLINE:
 	case CPU_ONLINE_FROZEN:
 		refresh_zone_stat_thresholds();
-		start_cpu_timer(cpu);
 		node_set_state(cpu_to_node(cpu), N_CPU);
+		cpumask_set_cpu(cpu, cpu_stat_off);
 		break;
 	case CPU_DOWN_PREPARE:
 	case CPU_DOWN_PREPARE_FROZEN:
 		cancel_delayed_work_sync(&per_cpu(vmstat_work, cpu));
-		per_cpu(vmstat_work, cpu).work.func = NULL;
+		cpumask_clear_cpu(cpu, cpu_stat_off);
 		break;
 	case CPU_DOWN_FAILED:
 	case CPU_DOWN_FAILED_FROZEN:
-		start_cpu_timer(cpu);
+		cpumask_set_cpu(cpu, cpu_stat_off);
 		break;
 	case CPU_DEAD:
 	case CPU_DEAD_FROZEN:
@@ -1231,12 +1346,9 @@ static struct notifier_block __cpuinitdata vmstat_notifier =
 static int __init setup_vmstat(void)
 {
 #ifdef CONFIG_SMP
-	int cpu;
-
 	register_cpu_notifier(&vmstat_notifier);
 
-	for_each_online_cpu(cpu)
-		start_cpu_timer(cpu);
+	start_shepherd_timer();
 #endif
 #ifdef CONFIG_PROC_FS
 	proc_create("buddyinfo", S_IRUGO, NULL, &fragmentation_file_operations);
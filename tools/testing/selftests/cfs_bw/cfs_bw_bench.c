@@ -0,0 +1,215 @@
+/*
+ * CFS bandwidth control scaling: many threads run in a cpu cgroup capped
+ * at half the online CPUs, each one alternating short CPU bursts and
+ * sleeps, so that every CPU keeps pulling runtime slices from the group's
+ * pool. Reports how much of the quota was actually consumed and the worst
+ * extra delay a thread saw while running a burst (throttling jitter), with
+ * and without cpu.cfs_burst_us.
+ *
+ * Needs root and the cpu controller mounted, otherwise the test is
+ * skipped, eg: ./cfs_bw_bench [seconds] [cpu cgroup mount]
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define NSEC_PER_USEC		1000ULL
+#define NSEC_PER_MSEC		1000000ULL
+#define NSEC_PER_SEC		1000000000ULL
+
+#define PERIOD_US		100000ULL
+#define RUN_NS			(1 * NSEC_PER_MSEC)
+#define SLEEP_NS		(1 * NSEC_PER_MSEC)
+
+static char group[256];
+static uint64_t end_time;
+
+struct result {
+	pthread_t thread;
+	unsigned long bursts;
+	uint64_t max_delay;
+};
+
+static uint64_t clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int write_file(const char *dir, const char *name, unsigned long long val)
+{
+	char path[512];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	ret = fprintf(f, "%llu\n", val) < 0;
+	if (fclose(f))
+		ret = 1;
+
+	return ret ? -1 : 0;
+}
+
+static unsigned long long read_stat(const char *name)
+{
+	unsigned long long val = 0, v;
+	char path[512], key[64];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/cpu.stat", group);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %llu", key, &v) == 2) {
+		if (!strcmp(key, name))
+			val = v;
+	}
+	fclose(f);
+
+	return val;
+}
+
+static void *worker(void *arg)
+{
+	struct result *res = arg;
+	struct timespec ts = { 0, SLEEP_NS };
+	uint64_t start, cpu, delay;
+
+	while (clock_ns(CLOCK_MONOTONIC) < end_time) {
+		start = clock_ns(CLOCK_MONOTONIC);
+		cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) + RUN_NS;
+		while (clock_ns(CLOCK_THREAD_CPUTIME_ID) < cpu)
+			;
+
+		/* wall time spent beyond the CPU time we asked for */
+		delay = clock_ns(CLOCK_MONOTONIC) - start - RUN_NS;
+		if (delay > res->max_delay)
+			res->max_delay = delay;
+		res->bursts++;
+
+		nanosleep(&ts, NULL);
+	}
+
+	return NULL;
+}
+
+static int bench(const char *name, int nr_threads, int seconds,
+		 unsigned long long quota_us, unsigned long long burst_us)
+{
+	unsigned long long throttled, throttled_time, periods;
+	uint64_t cpu, allowed, max_delay = 0;
+	unsigned long bursts = 0;
+	struct result *res;
+	int i, ret = 0;
+
+	/* burst must be lowered first, it can't exceed the quota */
+	if (write_file(group, "cpu.cfs_burst_us", 0) && burst_us) {
+		printf("%-8s no cpu.cfs_burst_us support, skipping\n", name);
+		return 0;
+	}
+	if (write_file(group, "cpu.cfs_quota_us", quota_us) ||
+	    (burst_us && write_file(group, "cpu.cfs_burst_us", burst_us))) {
+		perror("cfs bandwidth");
+		return -1;
+	}
+
+	res = calloc(nr_threads, sizeof(*res));
+	if (!res)
+		return -1;
+
+	periods = read_stat("nr_periods");
+	throttled = read_stat("nr_throttled");
+	throttled_time = read_stat("throttled_time");
+	cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+	end_time = clock_ns(CLOCK_MONOTONIC) + seconds * NSEC_PER_SEC;
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&res[i].thread, NULL, worker, &res[i])) {
+			perror("pthread_create");
+			nr_threads = i;
+			ret = -1;
+			break;
+		}
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(res[i].thread, NULL);
+		bursts += res[i].bursts;
+		if (res[i].max_delay > max_delay)
+			max_delay = res[i].max_delay;
+	}
+
+	cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+	periods = read_stat("nr_periods") - periods;
+	throttled = read_stat("nr_throttled") - throttled;
+	throttled_time = read_stat("throttled_time") - throttled_time;
+	allowed = quota_us * NSEC_PER_USEC * (seconds * NSEC_PER_SEC /
+					      (PERIOD_US * NSEC_PER_USEC));
+
+	if (!ret) {
+		printf("%-8s %d threads: %lu bursts, quota used %llu%%, max delay %llu us\n",
+		       name, nr_threads, bursts,
+		       (unsigned long long)(cpu * 100 / allowed),
+		       (unsigned long long)(max_delay / NSEC_PER_USEC));
+		printf("%-8s %llu periods, %llu throttled, throttled time %llu us\n",
+		       name, periods, throttled,
+		       throttled_time / NSEC_PER_USEC);
+	}
+	free(res);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const char *mount = "/sys/fs/cgroup/cpu";
+	unsigned long long quota_us;
+	int seconds = 5, nr_cpus, ret;
+
+	if (argc > 1)
+		seconds = atoi(argv[1]);
+	if (argc > 2)
+		mount = argv[2];
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [seconds] [cpu cgroup mount]\n",
+			argv[0]);
+		return 1;
+	}
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	quota_us = PERIOD_US * (nr_cpus > 1 ? nr_cpus / 2 : 1);
+
+	snprintf(group, sizeof(group), "%s/cfs_bw_bench.%d", mount, getpid());
+	if (mkdir(group, 0755) && errno != EEXIST) {
+		printf("No cpu cgroup at %s or not root, skipping\n", mount);
+		return 0;
+	}
+	if (write_file(group, "cpu.cfs_period_us", PERIOD_US) ||
+	    write_file(group, "tasks", getpid())) {
+		printf("No CFS bandwidth control support, skipping\n");
+		rmdir(group);
+		return 0;
+	}
+
+	/* threads created from now on inherit the group */
+	ret = bench("noburst", 4 * nr_cpus, seconds, quota_us, 0);
+	if (!ret)
+		ret = bench("burst", 4 * nr_cpus, seconds, quota_us, quota_us);
+
+	write_file(mount, "tasks", getpid());
+	rmdir(group);
+
+	return ret < 0;
+}
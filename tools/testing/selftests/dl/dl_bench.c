@@ -0,0 +1,223 @@
+/*
+ * Deadline misses of a periodic task set, scheduled with SCHED_DEADLINE
+ * and then with SCHED_FIFO at a single priority for comparison.
+ *
+ * Each task releases a job every period, burns its runtime of CPU time
+ * and checks the job completed before its relative deadline. Deadline
+ * tasks must be allowed on their whole root domain, so to compare both
+ * policies on one CPU run it from a single CPU exclusive cpuset (or with
+ * maxcpus=1), eg: ./dl_bench [seconds]
+ * Setting the policies requires root, otherwise the test is skipped.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE		6
+#endif
+
+#define NSEC_PER_USEC		1000ULL
+#define NSEC_PER_MSEC		1000000ULL
+#define NSEC_PER_SEC		1000000000ULL
+
+/*
+ * A task set with 75% utilization: fine under EDF, but a FIFO order
+ * running the long job first makes the short one miss its deadline.
+ */
+static const struct task_params {
+	uint64_t runtime;
+	uint64_t deadline;
+	uint64_t period;
+} tasks[] = {
+	{ 5 * NSEC_PER_MSEC, 10 * NSEC_PER_MSEC, 10 * NSEC_PER_MSEC },
+	{ 1 * NSEC_PER_MSEC,  4 * NSEC_PER_MSEC,  4 * NSEC_PER_MSEC },
+};
+
+#define NR_TASKS		(sizeof(tasks) / sizeof(tasks[0]))
+
+struct sched_attr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+struct result {
+	unsigned long jobs;
+	unsigned long misses;
+	uint64_t max_lateness;
+};
+
+static uint64_t clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void ns_to_ts(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static int set_policy(int policy, const struct task_params *tp)
+{
+	struct sched_attr attr;
+	struct sched_param param;
+
+	if (policy == SCHED_FIFO) {
+		param.sched_priority = 50;
+		return sched_setscheduler(0, SCHED_FIFO, &param);
+	}
+
+#ifdef __NR_sched_setattr
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_runtime = tp->runtime;
+	attr.sched_deadline = tp->deadline;
+	attr.sched_period = tp->period;
+	return syscall(__NR_sched_setattr, 0, &attr, 0);
+#else
+	(void)attr;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static void burn(uint64_t ns)
+{
+	uint64_t end = clock_ns(CLOCK_THREAD_CPUTIME_ID) + ns;
+
+	while (clock_ns(CLOCK_THREAD_CPUTIME_ID) < end)
+		;
+}
+
+static void periodic_task(const struct task_params *tp, struct result *res,
+			  uint64_t start, uint64_t end)
+{
+	uint64_t release, done, late;
+	struct timespec ts;
+
+	for (release = start; release < end; release += tp->period) {
+		ns_to_ts(release, &ts);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+		/*
+		 * Leave some slack for the overheads, a deadline job
+		 * exceeding its runtime is throttled until next period.
+		 */
+		burn(tp->runtime * 9 / 10);
+		done = clock_ns(CLOCK_MONOTONIC);
+
+		res->jobs++;
+		if (done > release + tp->deadline) {
+			late = done - release - tp->deadline;
+			res->misses++;
+			if (late > res->max_lateness)
+				res->max_lateness = late;
+		}
+	}
+}
+
+/* Returns 1 if the policy can't be used, -1 on error */
+static int bench(const char *name, int policy, int seconds)
+{
+	struct result *res;
+	uint64_t start, end;
+	int status, ret = 0;
+	unsigned int i;
+	pid_t pid;
+
+	res = mmap(NULL, NR_TASKS * sizeof(*res), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (res == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	memset(res, 0, NR_TASKS * sizeof(*res));
+
+	/* Give the children the time to set their policy */
+	start = clock_ns(CLOCK_MONOTONIC) + NSEC_PER_SEC / 10;
+	end = start + seconds * NSEC_PER_SEC;
+
+	for (i = 0; i < NR_TASKS; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			ret = -1;
+			break;
+		}
+		if (!pid) {
+			if (set_policy(policy, &tasks[i]))
+				_exit(errno == EBUSY ? 2 : 1);
+			periodic_task(&tasks[i], &res[i], start, end);
+			_exit(0);
+		}
+	}
+
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || !WEXITSTATUS(status))
+			continue;
+		if (WEXITSTATUS(status) == 2)
+			printf("%-8s task rejected by the admission test\n", name);
+		else if (!ret)
+			ret = 1;
+	}
+
+	if (ret) {
+		munmap(res, NR_TASKS * sizeof(*res));
+		return ret;
+	}
+
+	for (i = 0; i < NR_TASKS; i++) {
+		printf("%-8s task %u: %lu jobs, %lu missed, max lateness %llu us\n",
+		       name, i, res[i].jobs, res[i].misses,
+		       (unsigned long long)(res[i].max_lateness / NSEC_PER_USEC));
+	}
+	munmap(res, NR_TASKS * sizeof(*res));
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int seconds = 5;
+	int ret;
+
+	if (argc > 1)
+		seconds = atoi(argv[1]);
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	ret = bench("deadline", SCHED_DEADLINE, seconds);
+	if (ret > 0)
+		printf("No SCHED_DEADLINE support or not root, skipping\n");
+	else if (ret < 0)
+		return 1;
+
+	ret = bench("fifo", SCHED_FIFO, seconds);
+	if (ret > 0)
+		printf("Can't set SCHED_FIFO, not root?\n");
+
+	return ret < 0;
+}
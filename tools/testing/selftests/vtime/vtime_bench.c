@@ -0,0 +1,113 @@
+/*
+ * Syscall overhead with the precise and the lazy full dynticks cputime
+ * accounting (CONFIG_VIRT_CPU_ACCOUNTING_GEN, cputime.vtime_lazy).
+ *
+ * The accounting only runs on full dynticks CPUs, so pass one of them
+ * as argument, eg: ./vtime_bench 3 [nr_loops]
+ * Switching the mode requires root, otherwise only the current mode is
+ * measured.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define VTIME_LAZY_PARAM	"/sys/module/cputime/parameters/vtime_lazy"
+
+static int get_mode(void)
+{
+	FILE *f;
+	int c;
+
+	f = fopen(VTIME_LAZY_PARAM, "r");
+	if (!f)
+		return -1;
+	c = fgetc(f);
+	fclose(f);
+	return c == 'Y' || c == '1';
+}
+
+static int set_mode(int lazy)
+{
+	FILE *f;
+	int ret;
+
+	f = fopen(VTIME_LAZY_PARAM, "w");
+	if (!f)
+		return -1;
+	ret = fputs(lazy ? "1" : "0", f);
+	if (fclose(f) || ret < 0)
+		return -1;
+	return get_mode() == lazy ? 0 : -1;
+}
+
+static double tv_to_sec(struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void bench(const char *mode, unsigned long loops)
+{
+	struct timespec start, end;
+	struct rusage ru0, ru1;
+	unsigned long i;
+	double ns;
+
+	getrusage(RUSAGE_SELF, &ru0);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < loops; i++)
+		syscall(__NR_getppid);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	getrusage(RUSAGE_SELF, &ru1);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("%-8s %8.1f ns/syscall  user %6.3fs  sys %6.3fs\n",
+	       mode, ns / loops,
+	       tv_to_sec(&ru1.ru_utime) - tv_to_sec(&ru0.ru_utime),
+	       tv_to_sec(&ru1.ru_stime) - tv_to_sec(&ru0.ru_stime));
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long loops = 1000000;
+	cpu_set_t set;
+	int orig;
+
+	if (argc > 1) {
+		CPU_ZERO(&set);
+		CPU_SET(atoi(argv[1]), &set);
+		if (sched_setaffinity(0, sizeof(set), &set)) {
+			perror("sched_setaffinity");
+			return 1;
+		}
+	}
+	if (argc > 2)
+		loops = strtoul(argv[2], NULL, 0);
+
+	orig = get_mode();
+	if (orig < 0) {
+		printf("No lazy vtime support, measuring the current mode\n");
+		bench("current", loops);
+		return 0;
+	}
+
+	if (set_mode(0) || set_mode(1)) {
+		printf("Can't switch vtime mode, measuring the current mode\n");
+		bench(orig ? "lazy" : "precise", loops);
+		return 0;
+	}
+
+	set_mode(0);
+	bench("precise", loops);
+	set_mode(1);
+	bench("lazy", loops);
+	set_mode(orig);
+
+	return 0;
+}